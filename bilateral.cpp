@@ -0,0 +1,350 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <math.h>
+#include "image.h"
+
+
+#define BILATERAL_GRID_FILTER_SIDE  5       ///< Grid blur side in cells, standard deviation of one cell
+#define BILATERAL_WINDOW_SIGMAS     2       ///< Brute force window radius in spatial sigmas
+
+/*
+ * @brief: Axis of a grid blur pass
+ */
+enum class GridAxis
+{
+    X,
+    Y,
+    VALUE
+};
+
+/*
+ * @brief: Data shared by the threads of a bilateral pass
+ */
+struct BilateralData
+{
+    const float* source;            ///< Row-major source matrix
+    float* outImage;                ///< Output matrix
+    int width;                      ///< Image width
+    int height;                     ///< Image height
+    float spatialSigma;             ///< Spatial standard deviation, grid cell side in pixels
+    float rangeSigma;               ///< Range standard deviation, grid cell depth in levels
+    float minValue;                 ///< Smallest image value, at the first grid level
+    int gridWidth;                  ///< Grid cells along x
+    int gridHeight;                 ///< Grid cells along y
+    int gridDepth;                  ///< Grid cells along the values
+    int gridPadding;                ///< Empty cells around the splatted ones
+    const float* inValues;          ///< Pass input sums of values
+    const float* inWeights;         ///< Pass input sums of weights
+    float* values;                  ///< Pass output sums of values
+    float* weights;                 ///< Pass output sums of weights
+    const float* filter;            ///< Normalized 1D gaussian of the grid blur
+    GridAxis axis;                  ///< Grid blur axis
+    int radius;                     ///< Brute force window radius
+    const float* spatialWeights;    ///< Brute force window spatial weights
+};
+
+void threadBilateralSplat(const BilateralData* data, int startRow, int stopRow);
+
+void threadBilateralBlur(const BilateralData* data, int startRow, int stopRow);
+
+void threadBilateralSlice(const BilateralData* data, int startLine, int stopLine);
+
+void threadBilateralBruteForce(const BilateralData* data, int startLine, int stopLine);
+
+void threadBilateralSplat(const BilateralData* data, int startRow, int stopRow)
+{
+    // Every thread owns the grid rows [startRow, stopRow), and so the image
+    // rows falling in them: no two threads write the same cell
+    int rowSize = data->gridWidth * data->gridDepth;
+    for (int y = 0; y < data->height; y++) {
+        int gy = static_cast<int>(y / data->spatialSigma + 0.5f) + data->gridPadding;
+        if (gy < startRow || gy >= stopRow) {
+            continue;
+        }
+
+        const float* sourceRow = data->source + y * data->width;
+        float* valuesRow = data->values + gy * rowSize;
+        float* weightsRow = data->weights + gy * rowSize;
+        for (int x = 0; x < data->width; x++) {
+            int gx = static_cast<int>(x / data->spatialSigma + 0.5f) + data->gridPadding;
+            int gz = static_cast<int>((sourceRow[x] - data->minValue) / data->rangeSigma + 0.5f) +
+                        data->gridPadding;
+            int cell = gx * data->gridDepth + gz;
+            valuesRow[cell] += sourceRow[x];
+            weightsRow[cell] += 1;
+        }
+    }
+}
+
+void threadBilateralBlur(const BilateralData* data, int startRow, int stopRow)
+{
+    int gridWidth = data->gridWidth;
+    int gridDepth = data->gridDepth;
+    int filterRadius = BILATERAL_GRID_FILTER_SIDE / 2;
+    const float* filter = data->filter + filterRadius;
+
+    // Cells outside the grid are empty, taps falling there are dropped
+    int length = data->axis == GridAxis::X ? gridWidth : data->gridHeight;
+    int stride = data->axis == GridAxis::X ? gridDepth : gridWidth * gridDepth;
+
+    for (int gy = startRow; gy < stopRow; gy++) {
+        for (int gx = 0; gx < gridWidth; gx++) {
+            int cell = (gy * gridWidth + gx) * gridDepth;
+            const float* inValues = data->inValues + cell;
+            const float* inWeights = data->inWeights + cell;
+            float* __restrict__ values = data->values + cell;
+            float* __restrict__ weights = data->weights + cell;
+
+            if (data->axis == GridAxis::VALUE) {
+                for (int gz = 0; gz < gridDepth; gz++) {
+                    float value = 0;
+                    float weight = 0;
+                    for (int k = std::max(-filterRadius, -gz); k <= std::min(filterRadius, gridDepth - 1 - gz); k++) {
+                        value += filter[k] * inValues[gz + k];
+                        weight += filter[k] * inWeights[gz + k];
+                    }
+                    values[gz] = value;
+                    weights[gz] = weight;
+                }
+                continue;
+            }
+
+            // Whole value rows of the neighbouring cells, unit stride
+            int position = data->axis == GridAxis::X ? gx : gy;
+            std::fill(values, values + gridDepth, 0.0f);
+            std::fill(weights, weights + gridDepth, 0.0f);
+            for (int k = std::max(-filterRadius, -position); k <= std::min(filterRadius, length - 1 - position); k++) {
+                const float* __restrict__ tapValues = inValues + k * stride;
+                const float* __restrict__ tapWeights = inWeights + k * stride;
+                for (int gz = 0; gz < gridDepth; gz++) {
+                    values[gz] += filter[k] * tapValues[gz];
+                    weights[gz] += filter[k] * tapWeights[gz];
+                }
+            }
+        }
+    }
+}
+
+void threadBilateralSlice(const BilateralData* data, int startLine, int stopLine)
+{
+    int gridDepth = data->gridDepth;
+    int rowSize = data->gridWidth * gridDepth;
+
+    for (int y = startLine; y < stopLine; y++) {
+        float fy = y / data->spatialSigma + data->gridPadding;
+        int gy = static_cast<int>(fy);
+        float ty = fy - gy;
+
+        const float* sourceRow = data->source + y * data->width;
+        float* outRow = data->outImage + y * data->width;
+        for (int x = 0; x < data->width; x++) {
+            float fx = x / data->spatialSigma + data->gridPadding;
+            float fz = (sourceRow[x] - data->minValue) / data->rangeSigma + data->gridPadding;
+            int gx = static_cast<int>(fx);
+            int gz = static_cast<int>(fz);
+            float tx = fx - gx;
+            float tz = fz - gz;
+
+            // Trilinear interpolation of values and weights
+            float value = 0;
+            float weight = 0;
+            for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                    float wxy = (dy ? ty : 1 - ty) * (dx ? tx : 1 - tx);
+                    int cell = (gy + dy) * rowSize + (gx + dx) * gridDepth + gz;
+                    value += wxy * ((1 - tz) * data->inValues[cell] + tz * data->inValues[cell + 1]);
+                    weight += wxy * ((1 - tz) * data->inWeights[cell] + tz * data->inWeights[cell + 1]);
+                }
+            }
+            outRow[x] = weight > 0 ? value / weight : sourceRow[x];
+        }
+    }
+}
+
+void threadBilateralBruteForce(const BilateralData* data, int startLine, int stopLine)
+{
+    int radius = data->radius;
+    int side = 2 * radius + 1;
+    float rangeFactor = -1.0f / (2 * data->rangeSigma * data->rangeSigma);
+
+    for (int y = startLine; y < stopLine; y++) {
+        for (int x = 0; x < data->width; x++) {
+            float center = data->source[y * data->width + x];
+            float value = 0;
+            float weight = 0;
+            for (int dy = std::max(-radius, -y); dy <= std::min(radius, data->height - 1 - y); dy++) {
+                const float* row = data->source + (y + dy) * data->width;
+                const float* spatialRow = data->spatialWeights + (dy + radius) * side + radius;
+                for (int dx = std::max(-radius, -x); dx <= std::min(radius, data->width - 1 - x); dx++) {
+                    float difference = row[x + dx] - center;
+                    float w = spatialRow[dx] * expf(difference * difference * rangeFactor);
+                    value += w * row[x + dx];
+                    weight += w;
+                }
+            }
+            data->outImage[y * data->width + x] = value / weight;
+        }
+    }
+}
+
+/*
+ * @brief: run a pass splitting rows in bands among threads
+ */
+static void runBilateralPass(void (*pass)(const BilateralData*, int, int),
+                                const BilateralData& data, int linesNumber, int threadsNumber)
+{
+    if (threadsNumber == 1) {
+        pass(&data, 0, linesNumber);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    int bandsNumber = std::min(threadsNumber, std::max(linesNumber, 1));
+    for (int i = 0; i < bandsNumber; i++) {
+        int startLine = linesNumber / bandsNumber * i;
+        int stopLine = i == bandsNumber - 1 ? linesNumber : linesNumber / bandsNumber * (i + 1);
+        threads.push_back(std::thread(pass, &data, startLine, stopLine));
+    }
+    for (unsigned int i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+bool Image::bilateralFilter(Image& resultingImage, float spatialSigma, float rangeSigma,
+                            int threadsNumber, BilateralAlgorithm algorithm) const
+{
+    std::cout << "Applying bilateral filter to image" << std::endl;
+
+    // Get image dimensions
+    int height = this->getImageHeight();
+    int width = this->getImageWidth();
+
+    if (spatialSigma <= 0 || rangeSigma <= 0 || threadsNumber <= 0) {
+        std::cerr << "Invalid bilateral parameters" << std::endl;
+        return false;
+    }
+
+    std::cout << "Algorithm: " << (algorithm == BilateralAlgorithm::GRID ? "grid" : "brute force")
+              << ", spatial sigma: " << spatialSigma << ", range sigma: " << rangeSigma
+              << ", threads: " << threadsNumber << std::endl;
+
+    std::vector<float> rowMajorImage;
+    if (m_layout == ImageLayout::TILED) {
+        rowMajorImage = getImage();
+    }
+    std::vector<float> newImage(height * width);
+
+    BilateralData data;
+    data.source = m_layout == ImageLayout::TILED ? rowMajorImage.data() : m_image.data();
+    data.outImage = newImage.data();
+    data.width = width;
+    data.height = height;
+    data.spatialSigma = spatialSigma;
+    data.rangeSigma = rangeSigma;
+
+    if (algorithm == BilateralAlgorithm::BRUTE_FORCE) {
+        data.radius = ceil(BILATERAL_WINDOW_SIGMAS * spatialSigma);
+        int side = 2 * data.radius + 1;
+        std::vector<float> spatialWeights(side * side);
+        for (int i = -data.radius; i <= data.radius; i++) {
+            for (int j = -data.radius; j <= data.radius; j++) {
+                spatialWeights[(i + data.radius) * side + j + data.radius] =
+                    exp(-(i * i + j * j) / (2 * spatialSigma * spatialSigma));
+            }
+        }
+        data.spatialWeights = spatialWeights.data();
+        std::cout << "Window: " << side << "x" << side << std::endl;
+
+        auto t1 = std::chrono::high_resolution_clock::now();
+        runBilateralPass(threadBilateralBruteForce, data, height, threadsNumber);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        auto filterDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+        std::cout << "Bilateral filtering execution time: " << filterDuration << " μs" << std::endl;
+
+        resultingImage.setImage(newImage, width, height);
+
+        std::cout << "Done!" << std::endl;
+
+        return true;
+    }
+
+    // Grid blur: the 1D factor of the gaussian kernel, one cell of deviation
+    Kernel gaussian;
+    std::vector<float> columnFilter;
+    std::vector<float> rowFilter;
+    if (!gaussian.setGaussianFilter(BILATERAL_GRID_FILTER_SIDE, BILATERAL_GRID_FILTER_SIDE, 1) ||
+            !gaussian.getSeparableFilters(columnFilter, rowFilter)) {
+        return false;
+    }
+    float filterSum = 0;
+    for (unsigned int i = 0; i < rowFilter.size(); i++) {
+        filterSum += rowFilter[i];
+    }
+    for (unsigned int i = 0; i < rowFilter.size(); i++) {
+        rowFilter[i] /= filterSum;
+    }
+
+    float minValue = height * width > 0 ? *std::min_element(data.source, data.source + height * width) : 0;
+    float maxValue = height * width > 0 ? *std::max_element(data.source, data.source + height * width) : 0;
+
+    // One more cell for the interpolation, padding for the blur
+    data.minValue = minValue;
+    data.gridPadding = BILATERAL_GRID_FILTER_SIDE / 2;
+    data.gridWidth = static_cast<int>((width - 1) / spatialSigma) + 2 + 2 * data.gridPadding;
+    data.gridHeight = static_cast<int>((height - 1) / spatialSigma) + 2 + 2 * data.gridPadding;
+    data.gridDepth = static_cast<int>((maxValue - minValue) / rangeSigma) + 2 + 2 * data.gridPadding;
+    data.filter = rowFilter.data();
+    std::cout << "Grid: " << data.gridWidth << "x" << data.gridHeight << "x" << data.gridDepth
+              << " cells" << std::endl;
+
+    // Blur passes move between the grid and a buffer
+    int cellsNumber = data.gridWidth * data.gridHeight * data.gridDepth;
+    std::vector<float> gridValues(cellsNumber, 0.0f);
+    std::vector<float> gridWeights(cellsNumber, 0.0f);
+    std::vector<float> bufferValues(cellsNumber);
+    std::vector<float> bufferWeights(cellsNumber);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    data.values = gridValues.data();
+    data.weights = gridWeights.data();
+    runBilateralPass(threadBilateralSplat, data, data.gridHeight, threadsNumber);
+
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    const GridAxis axes[] = { GridAxis::X, GridAxis::Y, GridAxis::VALUE };
+    for (GridAxis axis : axes) {
+        data.axis = axis;
+        data.inValues = gridValues.data();
+        data.inWeights = gridWeights.data();
+        data.values = bufferValues.data();
+        data.weights = bufferWeights.data();
+        runBilateralPass(threadBilateralBlur, data, data.gridHeight, threadsNumber);
+        gridValues.swap(bufferValues);
+        gridWeights.swap(bufferWeights);
+    }
+
+    auto t3 = std::chrono::high_resolution_clock::now();
+
+    data.inValues = gridValues.data();
+    data.inWeights = gridWeights.data();
+    runBilateralPass(threadBilateralSlice, data, height, threadsNumber);
+
+    auto t4 = std::chrono::high_resolution_clock::now();
+
+    auto splatDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    auto blurDuration = std::chrono::duration_cast<std::chrono::microseconds>(t3 - t2).count();
+    auto sliceDuration = std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3).count();
+    auto filterDuration = std::chrono::duration_cast<std::chrono::microseconds>(t4 - t1).count();
+    std::cout << "Splat execution time: " << splatDuration << " μs" << std::endl;
+    std::cout << "Grid blur execution time: " << blurDuration << " μs" << std::endl;
+    std::cout << "Slice execution time: " << sliceDuration << " μs" << std::endl;
+    std::cout << "Bilateral filtering execution time: " << filterDuration << " μs" << std::endl;
+
+    resultingImage.setImage(newImage, width, height);
+
+    std::cout << "Done!" << std::endl;
+
+    return true;
+}
@@ -0,0 +1,685 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <map>
+#include <algorithm>
+#include <utility>
+#include <functional>
+#include <future>
+#include "check.h"
+#include "image.h"
+#include "shard.h"
+#include "lazy.h"
+
+
+#define CHECK_REPETITIONS       3
+#define CHECK_OPERATOR_IMAGE    1       ///< Source image of the operator goldens
+#define CHECK_PYRAMID_LEVELS    4       ///< Levels of the pyramid golden
+#define CHECK_REFERENCE_LEVELS  6       ///< Levels compared with the filter-then-decimate reference
+#define CHECK_JOB_TIMEOUT_S     5       ///< Longest wait for a job in the executor checks
+
+/*
+ * @brief: An execution path producing a filtered image
+ */
+struct CheckPath
+{
+    std::string name;
+    bool separableOnly;         ///< Path applies to separable kernels only
+    std::function<bool(const Image&, Image&, const Kernel&, int)> run;
+};
+
+/*
+ * @brief: An execution path of an operator other than the convolution
+ *          filters. Its outputs are compared with the goldens N_golden.png,
+ *          or N_golden_1.png, N_golden_2.png, ... for several outputs.
+ */
+struct OperatorPath
+{
+    std::string golden;
+    std::string name;
+    int outputsNumber;
+    std::function<bool(const Image&, std::vector<Image>&, int)> run;
+};
+
+static bool runMultithread(const Image& source, Image& result, const Kernel& kernel,
+                            int threadsNumber, FilterAlgorithm algorithm, FilterPartition partition)
+{
+    FilterOptions options;
+    options.threadsNumber = threadsNumber;
+    options.algorithm = algorithm;
+    options.partition = partition;
+
+    return source.multithreadFiltering(result, kernel, options);
+}
+
+static bool runShard(const Image& source, Image& result, const Kernel& kernel,
+                        int processesNumber, const char* transportName, FilterAlgorithm algorithm)
+{
+    SharedMemoryTransport sharedMemoryTransport;
+    StreamTransport streamTransport;
+    ShardTransport& transport = std::string(transportName) == SHARD_TRANSPORT_SHM ?
+                                    static_cast<ShardTransport&>(sharedMemoryTransport) :
+                                    static_cast<ShardTransport&>(streamTransport);
+    FilterOptions options;
+    options.algorithm = algorithm;
+
+    return ShardCoordinator(transport, processesNumber).filter(source, result, kernel, options);
+}
+
+/*
+ * @brief: return every execution path to be checked. New optimized
+ *          paths must be added here.
+ */
+static std::vector<CheckPath> getCheckPaths()
+{
+    using namespace std::placeholders;
+    std::vector<CheckPath> paths;
+
+    CheckPath sequential;
+    sequential.name = "sequential";
+    sequential.separableOnly = false;
+    sequential.run = [](const Image& source, Image& result, const Kernel& kernel, int) {
+        return source.applyFilter(result, kernel);
+    };
+    paths.push_back(sequential);
+
+    const FilterAlgorithm algorithms[] = { FilterAlgorithm::DIRECT,
+                                           FilterAlgorithm::VECTORIZED,
+                                           FilterAlgorithm::SEPARABLE };
+    const FilterPartition partitions[] = { FilterPartition::ROW_BANDS, FilterPartition::TILES };
+    for (FilterAlgorithm algorithm : algorithms) {
+        for (FilterPartition partition : partitions) {
+            CheckPath path;
+            path.name = std::string(algorithm == FilterAlgorithm::DIRECT ? "direct" :
+                                    algorithm == FilterAlgorithm::VECTORIZED ? "vectorized" :
+                                    "separable") +
+                        (partition == FilterPartition::TILES ? "_tiles" : "_bands");
+            path.separableOnly = algorithm == FilterAlgorithm::SEPARABLE;
+            path.run = std::bind(runMultithread, _1, _2, _3, _4, algorithm, partition);
+            paths.push_back(path);
+        }
+    }
+
+    CheckPath async;
+    async.name = "async";
+    async.separableOnly = false;
+    async.run = [](const Image& source, Image& result, const Kernel& kernel, int threadsNumber) {
+        FilterOptions options;
+        options.threadsNumber = threadsNumber;
+        return source.submitFilter(result, kernel, options)->wait();
+    };
+    paths.push_back(async);
+
+    CheckPath tiled;
+    tiled.name = "tiled";
+    tiled.separableOnly = false;
+    tiled.run = [](const Image& source, Image& result, const Kernel& kernel, int threadsNumber) {
+        Image blocks;
+        blocks.setLayout(ImageLayout::TILED, IMAGE_DEFAULT_BLOCK_SIZE);
+        blocks.setImage(source.getImage(), source.getImageWidth(), source.getImageHeight());
+        FilterOptions options;
+        options.threadsNumber = threadsNumber;
+        return blocks.multithreadFiltering(result, kernel, options);
+    };
+    paths.push_back(tiled);
+
+    CheckPath lazy;
+    lazy.name = "lazy";
+    lazy.separableOnly = false;
+    lazy.run = [](const Image& source, Image& result, const Kernel& kernel, int threadsNumber) {
+        FilterOptions options;
+        options.threadsNumber = threadsNumber;
+        return LazyImage(source).filter(kernel).evaluate(result, options);
+    };
+    paths.push_back(lazy);
+
+    const char* transports[] = { SHARD_TRANSPORT_SHM, SHARD_TRANSPORT_STREAM };
+    for (const char* transportName : transports) {
+        CheckPath shard;
+        shard.name = std::string("shard_") + transportName;
+        shard.separableOnly = false;
+        shard.run = std::bind(runShard, _1, _2, _3, _4, transportName, FilterAlgorithm::AUTO);
+        paths.push_back(shard);
+    }
+
+    // Workers run the algorithm resolved by the coordinator
+    const FilterAlgorithm shardAlgorithms[] = { FilterAlgorithm::VECTORIZED,
+                                                FilterAlgorithm::SEPARABLE };
+    for (FilterAlgorithm algorithm : shardAlgorithms) {
+        CheckPath shard;
+        shard.name = std::string("shard_") +
+                        (algorithm == FilterAlgorithm::VECTORIZED ? "vectorized" : "separable");
+        shard.separableOnly = algorithm == FilterAlgorithm::SEPARABLE;
+        shard.run = std::bind(runShard, _1, _2, _3, _4, SHARD_TRANSPORT_SHM, algorithm);
+        paths.push_back(shard);
+    }
+
+    return paths;
+}
+
+/*
+ * @brief: return the execution paths of the other operators. New
+ *          operators must be added here, with their goldens.
+ */
+static std::vector<OperatorPath> getOperatorPaths()
+{
+    std::vector<OperatorPath> paths;
+
+    Kernel pyramidKernel;
+    pyramidKernel.setGaussianFilter(5, 5, 1);
+    OperatorPath pyramid;
+    pyramid.golden = "pyramid";
+    pyramid.name = "streamed";
+    pyramid.outputsNumber = CHECK_PYRAMID_LEVELS;
+    pyramid.run = [pyramidKernel](const Image& source, std::vector<Image>& outputs, int threadsNumber) {
+        std::vector<Image*> levels;
+        for (Image& output : outputs) {
+            levels.push_back(&output);
+        }
+        return source.buildGaussianPyramid(levels, pyramidKernel, threadsNumber);
+    };
+    paths.push_back(pyramid);
+
+    const MedianAlgorithm medianAlgorithms[] = { MedianAlgorithm::HISTOGRAM, MedianAlgorithm::SORT };
+    for (MedianAlgorithm algorithm : medianAlgorithms) {
+        OperatorPath median;
+        median.golden = "median";
+        median.name = algorithm == MedianAlgorithm::HISTOGRAM ? "histogram" : "sort";
+        median.outputsNumber = 1;
+        median.run = [algorithm](const Image& source, std::vector<Image>& outputs, int threadsNumber) {
+            return source.medianFilter(outputs[0], 2, threadsNumber, algorithm);
+        };
+        paths.push_back(median);
+    }
+
+    OperatorPath opening;
+    opening.golden = "opening";
+    opening.name = "van_herk";
+    opening.outputsNumber = 1;
+    opening.run = [](const Image& source, std::vector<Image>& outputs, int threadsNumber) {
+        return source.morphologyFilter(outputs[0], MorphologyOperation::OPENING, 5, 5, threadsNumber);
+    };
+    paths.push_back(opening);
+
+    OperatorPath closing;
+    closing.golden = "closing";
+    closing.name = "van_herk";
+    closing.outputsNumber = 1;
+    closing.run = [](const Image& source, std::vector<Image>& outputs, int threadsNumber) {
+        return source.morphologyFilter(outputs[0], MorphologyOperation::CLOSING, 7, 3, threadsNumber);
+    };
+    paths.push_back(closing);
+
+    OperatorPath sobel;
+    sobel.golden = "sobel";
+    sobel.name = "l2";
+    sobel.outputsNumber = 1;
+    sobel.run = [](const Image& source, std::vector<Image>& outputs, int threadsNumber) {
+        return source.gradientFilter(outputs[0], GradientOperator::SOBEL, GradientNorm::L2, threadsNumber);
+    };
+    paths.push_back(sobel);
+
+    // Chain: gaussian, sharpen, clamp:16:240
+    Kernel gaussian;
+    Kernel sharpen;
+    gaussian.setFilter("gaussian");
+    sharpen.setFilter("sharpen");
+    OperatorPath lazy;
+    lazy.golden = "chain";
+    lazy.name = "lazy";
+    lazy.outputsNumber = 1;
+    lazy.run = [gaussian, sharpen](const Image& source, std::vector<Image>& outputs, int threadsNumber) {
+        FilterOptions options;
+        options.threadsNumber = threadsNumber;
+        return LazyImage(source).filter(gaussian, "gaussian").filter(sharpen, "sharpen")
+                                .clamp(16, 240).evaluate(outputs[0], options);
+    };
+    paths.push_back(lazy);
+
+    OperatorPath eager;
+    eager.golden = "chain";
+    eager.name = "eager";
+    eager.outputsNumber = 1;
+    eager.run = [gaussian, sharpen](const Image& source, std::vector<Image>& outputs, int threadsNumber) {
+        Image blurred;
+        if (!source.multithreadFiltering(blurred, gaussian, threadsNumber) ||
+                !blurred.multithreadFiltering(outputs[0], sharpen, threadsNumber)) {
+            return false;
+        }
+        std::vector<float> pixels = outputs[0].getImage();
+        for (float& value : pixels) {
+            value = std::min(std::max(value, 16.0f), 240.0f);
+        }
+        return outputs[0].setImage(std::move(pixels), source.getImageWidth(), source.getImageHeight());
+    };
+    paths.push_back(eager);
+
+    OperatorPath bilateral;
+    bilateral.golden = "bilateral";
+    bilateral.name = "grid";
+    bilateral.outputsNumber = 1;
+    bilateral.run = [](const Image& source, std::vector<Image>& outputs, int threadsNumber) {
+        return source.bilateralFilter(outputs[0], 4, 20, threadsNumber);
+    };
+    paths.push_back(bilateral);
+
+    return paths;
+}
+
+/*
+ * @brief: max absolute difference between the 8 bit conversion
+ *          of result (as saved by saveImage) and golden
+ */
+static int getMaxDifference(const std::vector<float>& result, const std::vector<float>& golden)
+{
+    int maxDifference = 0;
+    for (unsigned int i = 0; i < result.size(); i++) {
+        float value = result[i] < 0 ? 0 : (result[i] > 255 ? 255 : result[i]);
+        int difference = std::abs(static_cast<int>(value) - static_cast<int>(golden[i]));
+        if (difference > maxDifference) {
+            maxDifference = difference;
+        }
+    }
+
+    return maxDifference;
+}
+
+static bool loadBaseline(const std::string& path, std::map<std::string, double>& baseline)
+{
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string filter;
+        std::string path;
+        double mpixelsPerSecond = 0;
+        if (fields >> filter >> path >> mpixelsPerSecond) {
+            baseline[filter + " " + path] = mpixelsPerSecond;
+        }
+    }
+
+    return true;
+}
+
+/*
+ * @brief: print the result line of a path, compare its throughput with
+ *          the baseline and add it to the record
+ *
+ * @return: true if the path passed
+ */
+static bool reportPath(const std::string& filterName, const std::string& pathName, bool result,
+                        int maxDifference, double mpixelsPerSecond, const CheckSettings& settings,
+                        std::map<std::string, double>& baseline, bool hasBaseline,
+                        std::ostringstream& record)
+{
+    result = result && maxDifference <= settings.tolerance;
+
+    std::streamsize defaultPrecision = std::cout.precision();
+    std::cout << std::left << std::setw(20) << filterName << std::setw(18) << pathName
+              << "max diff " << std::setw(4) << maxDifference
+              << std::fixed << std::setprecision(1) << std::right << std::setw(8)
+              << mpixelsPerSecond << " Mpixel/s";
+
+    std::string key = filterName + " " + pathName;
+    if (hasBaseline && baseline.count(key) > 0) {
+        double change = (mpixelsPerSecond / baseline[key] - 1) * 100;
+        std::cout << " (baseline " << baseline[key] << ", "
+                  << std::showpos << change << std::noshowpos << "%)";
+        if (change < -settings.maxSlowdown) {
+            std::cout << " SLOWER";
+            result = false;
+        }
+    }
+    std::cout << (result ? " PASS" : " FAIL") << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::cout.precision(defaultPrecision);
+
+    record << key << " " << mpixelsPerSecond << std::endl;
+
+    return result;
+}
+
+/*
+ * @brief: filter with kernel at full resolution, pixels outside the image
+ *          repeating the nearest one, and keep the even rows and columns:
+ *          the reference of a pyramid level
+ */
+static std::vector<float> filterAndDecimate(const std::vector<float>& source, int width, int height,
+                                            const Kernel& kernel, int& levelWidth, int& levelHeight)
+{
+    std::vector<float> mask = kernel.getKernel();
+    int filterWidth = kernel.getKernelWidth();
+    int s = filterWidth / 2;
+
+    std::vector<float> filtered(source.size());
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            float sum = 0;
+            for (int h = -s; h <= s; h++) {
+                int sourceY = std::min(std::max(y + h, 0), height - 1);
+                for (int w = -s; w <= s; w++) {
+                    int sourceX = std::min(std::max(x + w, 0), width - 1);
+                    sum += mask[(h + s) * filterWidth + w + s] * source[sourceY * width + sourceX];
+                }
+            }
+            filtered[y * width + x] = std::min(std::max(sum, 0.0f), 255.0f);
+        }
+    }
+
+    levelWidth = (width + 1) / 2;
+    levelHeight = (height + 1) / 2;
+    std::vector<float> level(levelWidth * levelHeight);
+    for (int y = 0; y < levelHeight; y++) {
+        for (int x = 0; x < levelWidth; x++) {
+            level[y * levelWidth + x] = filtered[2 * y * width + 2 * x];
+        }
+    }
+
+    return level;
+}
+
+/*
+ * @brief: compare every pyramid level with the filter-then-decimate
+ *          reference, with thread counts above the height of the last levels
+ *
+ * @return: number of failed checks
+ */
+static int checkPyramid(const Image& source, const CheckSettings& settings)
+{
+    Kernel kernel;
+    std::streambuf* coutBuffer = std::cout.rdbuf(NULL);
+    kernel.setGaussianFilter(5, 5, 1);
+    std::cout.rdbuf(coutBuffer);
+
+    std::vector<std::vector<float>> references;
+    std::vector<float> level = source.getImage();
+    int width = source.getImageWidth();
+    int height = source.getImageHeight();
+    for (int l = 0; l < CHECK_REFERENCE_LEVELS; l++) {
+        level = filterAndDecimate(level, width, height, kernel, width, height);
+        references.push_back(level);
+    }
+
+    int failures = 0;
+    const int threadsNumbers[] = { 1, 3, 8, 64 };
+    for (int threadsNumber : threadsNumbers) {
+        std::vector<Image> outputs(CHECK_REFERENCE_LEVELS);
+        std::vector<Image*> levels;
+        for (Image& output : outputs) {
+            levels.push_back(&output);
+        }
+
+        coutBuffer = std::cout.rdbuf(NULL);
+        bool result = source.buildGaussianPyramid(levels, kernel, threadsNumber);
+        std::cout.rdbuf(coutBuffer);
+
+        int maxDifference = 0;
+        for (int l = 0; l < CHECK_REFERENCE_LEVELS && result; l++) {
+            std::vector<float> pixels = outputs[l].getImage();
+            if (pixels.size() != references[l].size()) {
+                result = false;
+                break;
+            }
+            maxDifference = std::max(maxDifference, getMaxDifference(pixels, references[l]));
+        }
+        result = result && maxDifference <= settings.tolerance;
+
+        std::cout << std::left << std::setw(20) << "pyramid_reference"
+                  << std::setw(18) << ("threads_" + std::to_string(threadsNumber))
+                  << "max diff " << std::setw(4) << maxDifference
+                  << (result ? " PASS" : " FAIL") << std::endl;
+        failures += result ? 0 : 1;
+    }
+
+    return failures;
+}
+
+/*
+ * @brief: true if the job finishes within the checks timeout, so that a
+ *          broken executor fails the check instead of hanging it
+ */
+static bool finishesInTime(const std::shared_ptr<Job>& job)
+{
+    return job->getFuture().wait_for(std::chrono::seconds(CHECK_JOB_TIMEOUT_S)) ==
+            std::future_status::ready;
+}
+
+/*
+ * @brief: check job chaining, cancellation and failure propagation of
+ *          the executor on a private single thread pool
+ *
+ * @return: number of failed checks
+ */
+static int checkExecutor()
+{
+    int failures = 0;
+    std::streambuf* cerrBuffer = std::cerr.rdbuf(NULL);
+    Executor executor(1);
+
+    // The single thread is held by a gate job, so later jobs stay queued
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::shared_ptr<Job> blocker = executor.submit([opened]() { opened.wait(); return true; });
+
+    std::shared_ptr<Job> cancelled = executor.submit([]() { return true; });
+    std::shared_ptr<Job> dependent = executor.submit([]() { return true; }, cancelled);
+    std::shared_ptr<Job> chained = executor.submit([]() { return true; }, dependent);
+    bool result = cancelled->cancel();
+    gate.set_value();
+    result = result && finishesInTime(chained) && !chained->wait() &&
+                dependent->getStatus() == JobStatus::CANCELLED &&
+                chained->getStatus() == JobStatus::CANCELLED && blocker->wait();
+    std::cerr.rdbuf(cerrBuffer);
+    std::cout << std::left << std::setw(38) << "executor cancel_dependents" << (result ? " PASS" : " FAIL") << std::endl;
+    failures += result ? 0 : 1;
+
+    cerrBuffer = std::cerr.rdbuf(NULL);
+    std::shared_ptr<Job> failed = executor.submit([]() { return false; });
+    std::shared_ptr<Job> throwing = executor.submit([]() -> bool { throw 1; });
+    std::shared_ptr<Job> nextStage = executor.submit([]() { return true; }, failed);
+    std::shared_ptr<Job> lastStage = executor.submit([]() { return true; }, nextStage);
+    result = finishesInTime(lastStage) && finishesInTime(throwing) && !lastStage->wait() &&
+                failed->getStatus() == JobStatus::FAILED && throwing->getStatus() == JobStatus::FAILED &&
+                nextStage->getStatus() == JobStatus::CANCELLED &&
+                lastStage->getStatus() == JobStatus::CANCELLED;
+    std::cerr.rdbuf(cerrBuffer);
+    std::cout << std::left << std::setw(38) << "executor failure_cancels_stages" << (result ? " PASS" : " FAIL") << std::endl;
+    failures += result ? 0 : 1;
+
+    cerrBuffer = std::cerr.rdbuf(NULL);
+    std::promise<void> callbackGate;
+    std::shared_future<void> callbackOpened = callbackGate.get_future().share();
+    std::shared_ptr<Job> held = executor.submit([callbackOpened]() { callbackOpened.wait(); return true; });
+    held->onComplete([](JobStatus) { throw std::runtime_error("callback"); });
+    callbackGate.set_value();
+    result = finishesInTime(held) && held->wait() && held->getStatus() == JobStatus::COMPLETED;
+    std::cerr.rdbuf(cerrBuffer);
+    std::cout << std::left << std::setw(38) << "executor throwing_callback" << (result ? " PASS" : " FAIL") << std::endl;
+    failures += result ? 0 : 1;
+
+    return failures;
+}
+
+bool runCheck(const CheckSettings& settings)
+{
+    std::vector<std::string> filters = Kernel::getFilterNames();
+    std::vector<CheckPath> paths = getCheckPaths();
+
+    // Load sources
+    std::vector<Image*> images;
+    for (int i = 1; i <= settings.imagesNumber; i++) {
+        images.push_back(new Image());
+        std::string imagePath = settings.imagesFolder + std::to_string(i) + ".png";
+        if (!images.back()->loadImage(imagePath.c_str())) {
+            for (unsigned int j = 0; j < images.size(); j++) {
+                delete images[j];
+            }
+            return false;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    bool hasBaseline = !settings.recordBaseline && loadBaseline(settings.baselinePath, baseline);
+    if (!settings.recordBaseline && !hasBaseline) {
+        std::cout << "No performance baseline in " << settings.baselinePath
+                  << ", throughput is not checked (run make check-baseline)" << std::endl;
+    }
+
+    std::ostringstream record;
+    record << "# filter path mpixel_per_s" << std::endl;
+
+    int failures = checkExecutor();
+    for (const std::string& filterName : filters) {
+        Kernel kernel;
+        std::streambuf* coutBuffer = std::cout.rdbuf(NULL);
+        kernel.setFilter(filterName);
+        std::cout.rdbuf(coutBuffer);
+        bool separable = kernel.isSeparable();
+
+        for (const CheckPath& path : paths) {
+            if (path.separableOnly && !separable) {
+                continue;
+            }
+
+            double totalSeconds = 0;
+            double totalMpixels = 0;
+            int maxDifference = 0;
+            bool result = true;
+
+            for (int i = 0; i < settings.imagesNumber; i++) {
+                std::string goldenPath = settings.goldenFolder + std::to_string(i + 1) +
+                                            "_" + filterName + ".png";
+                Image golden;
+                if (!golden.loadImage(goldenPath.c_str()) ||
+                        golden.getImageWidth() != images[i]->getImageWidth() ||
+                        golden.getImageHeight() != images[i]->getImageHeight()) {
+                    std::cerr << "Missing or invalid golden output " << goldenPath << std::endl;
+                    result = false;
+                    break;
+                }
+
+                // Best of some runs, filtering logs are silenced
+                double bestSeconds = 0;
+                Image filtered;
+                coutBuffer = std::cout.rdbuf(NULL);
+                for (int r = 0; r < CHECK_REPETITIONS && result; r++) {
+                    auto t1 = std::chrono::high_resolution_clock::now();
+                    result = path.run(*images[i], filtered, kernel, settings.threadsNumber);
+                    auto t2 = std::chrono::high_resolution_clock::now();
+                    double seconds = std::chrono::duration<double>(t2 - t1).count();
+                    if (r == 0 || seconds < bestSeconds) {
+                        bestSeconds = seconds;
+                    }
+                }
+                std::cout.rdbuf(coutBuffer);
+
+                if (!result || filtered.getImage().size() != golden.getImage().size()) {
+                    result = false;
+                    break;
+                }
+
+                int difference = getMaxDifference(filtered.getImage(), golden.getImage());
+                if (difference > maxDifference) {
+                    maxDifference = difference;
+                }
+
+                totalSeconds += bestSeconds;
+                totalMpixels += images[i]->getImageWidth() * images[i]->getImageHeight() / 1e6;
+            }
+
+            double mpixelsPerSecond = totalSeconds > 0 ? totalMpixels / totalSeconds : 0;
+            if (!reportPath(filterName, path.name, result, maxDifference, mpixelsPerSecond,
+                            settings, baseline, hasBaseline, record)) {
+                failures++;
+            }
+        }
+    }
+
+    // Other operators, on a single image
+    std::streambuf* coutBuffer = std::cout.rdbuf(NULL);
+    std::vector<OperatorPath> operatorPaths = getOperatorPaths();
+    std::cout.rdbuf(coutBuffer);
+    if (settings.imagesNumber < CHECK_OPERATOR_IMAGE) {
+        operatorPaths.clear();
+    }
+    for (const OperatorPath& path : operatorPaths) {
+        const Image& operatorSource = *images[CHECK_OPERATOR_IMAGE - 1];
+        std::vector<Image> goldens(path.outputsNumber);
+        bool result = true;
+        for (int o = 0; o < path.outputsNumber && result; o++) {
+            std::string goldenPath = settings.goldenFolder + std::to_string(CHECK_OPERATOR_IMAGE) +
+                                        "_" + path.golden +
+                                        (path.outputsNumber > 1 ? "_" + std::to_string(o + 1) : "") + ".png";
+            if (!goldens[o].loadImage(goldenPath.c_str())) {
+                std::cerr << "Missing or invalid golden output " << goldenPath << std::endl;
+                result = false;
+            }
+        }
+
+        // Best of some runs, operators logs are silenced
+        double bestSeconds = 0;
+        std::vector<Image> outputs(path.outputsNumber);
+        coutBuffer = std::cout.rdbuf(NULL);
+        for (int r = 0; r < CHECK_REPETITIONS && result; r++) {
+            auto t1 = std::chrono::high_resolution_clock::now();
+            result = path.run(operatorSource, outputs, settings.threadsNumber);
+            auto t2 = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration<double>(t2 - t1).count();
+            if (r == 0 || seconds < bestSeconds) {
+                bestSeconds = seconds;
+            }
+        }
+        std::cout.rdbuf(coutBuffer);
+
+        int maxDifference = 0;
+        for (int o = 0; o < path.outputsNumber && result; o++) {
+            std::vector<float> pixels = outputs[o].getImage();
+            std::vector<float> golden = goldens[o].getImage();
+            if (pixels.size() != golden.size()) {
+                result = false;
+                break;
+            }
+            maxDifference = std::max(maxDifference, getMaxDifference(pixels, golden));
+        }
+
+        double mpixels = operatorSource.getImageWidth() * operatorSource.getImageHeight() / 1e6;
+        double mpixelsPerSecond = bestSeconds > 0 ? mpixels / bestSeconds : 0;
+        if (!reportPath(path.golden, path.name, result, maxDifference, mpixelsPerSecond,
+                        settings, baseline, hasBaseline, record)) {
+            failures++;
+        }
+    }
+
+    if (settings.imagesNumber >= CHECK_OPERATOR_IMAGE) {
+        failures += checkPyramid(*images[CHECK_OPERATOR_IMAGE - 1], settings);
+    }
+
+    for (unsigned int i = 0; i < images.size(); i++) {
+        delete images[i];
+    }
+
+    if (settings.recordBaseline) {
+        std::ofstream file(settings.baselinePath.c_str());
+        if (!file || !(file << record.str())) {
+            std::cerr << "Unable to write baseline " << settings.baselinePath << std::endl;
+            return false;
+        }
+        std::cout << "Baseline saved in " << settings.baselinePath << std::endl;
+    }
+
+    std::cout << (failures == 0 ? "All checks passed" : std::to_string(failures) + " checks failed")
+              << " (tolerance: " << settings.tolerance << " levels, max slowdown: "
+              << settings.maxSlowdown << "%)" << std::endl;
+
+    return failures == 0;
+}
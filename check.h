@@ -0,0 +1,40 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <string>
+
+
+#define CHECK_BASELINE_DEFAULT_PATH     "check_baseline.txt"
+
+/*
+ * @brief: Settings of the golden output and performance regression check
+ */
+struct CheckSettings
+{
+    CheckSettings() :
+        imagesFolder("images/"), goldenFolder("tests/golden/"),
+        baselinePath(CHECK_BASELINE_DEFAULT_PATH), imagesNumber(3),
+        threadsNumber(4), tolerance(1), maxSlowdown(10), recordBaseline(false) {}
+
+    std::string imagesFolder;       ///< Folder with the N.png source images
+    std::string goldenFolder;       ///< Folder with the N_filter.png and N_operator.png golden outputs
+    std::string baselinePath;       ///< Throughput baseline file
+    int imagesNumber;               ///< Images 1..imagesNumber are checked
+    int threadsNumber;              ///< Threads used by the multithread paths
+    int tolerance;                  ///< Max absolute difference from golden, in 8 bit levels
+    double maxSlowdown;             ///< Max throughput drop below baseline, in percent
+    bool recordBaseline;            ///< Write the baseline instead of checking against it
+};
+
+/*
+ * @brief: run every filter on the source images through every execution
+ *          path, and the other operators on the first image, compare the
+ *          results with the golden outputs and the throughput with the
+ *          recorded baseline
+ *
+ * @params[in]: settings: check settings
+ * @return: true if every comparison passed, false otherwise
+ */
+bool runCheck(const CheckSettings& settings);
+
+#endif
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <vector>
+#include <math.h>
+#include "convolution.h"
+
+
+void threadConvBand(RegionConv conv, const ConvData* data, int startLine, int stopLine)
+{
+    conv(*data, startLine, stopLine, 0, data->width);
+}
+
+void threadConvTiles(RegionConv conv, const ConvData* data, int tileSize, std::atomic<int>* nextTile)
+{
+    int tilesPerRow = (data->width + tileSize - 1) / tileSize;
+    int tilesPerColumn = (data->height + tileSize - 1) / tileSize;
+    int tilesNumber = tilesPerRow * tilesPerColumn;
+
+    // Tiles are picked in row-major order, so that concurrent
+    // threads share the padded rows they read
+    for (int t = nextTile->fetch_add(1); t < tilesNumber; t = nextTile->fetch_add(1)) {
+        int startLine = (t / tilesPerRow) * tileSize;
+        int startColumn = (t % tilesPerRow) * tileSize;
+        int stopLine = std::min(startLine + tileSize, data->height);
+        int stopColumn = std::min(startColumn + tileSize, data->width);
+
+        conv(*data, startLine, stopLine, startColumn, stopColumn);
+    }
+}
+
+void convDirect(const ConvData& data, int startLine, int stopLine, 
+                int startColumn, int stopColumn)
+{
+    int filterWidth = data.filterWidth;
+    int paddedWidth = data.width + floor(filterWidth / 2) * 2;
+    int s = floor(filterWidth / 2);
+
+    int filterRowIndex = 0;
+    int sourceImgRowIndex = 0;
+    int outImgRowIndex = 0;
+    float pixelSum = 0.0f;
+
+    // Apply convolution
+    for (int l = startLine + s; l < stopLine + s; l++) {
+        outImgRowIndex = (l - s) * data.width;
+        for (int j = startColumn + s; j < stopColumn + s; j++) {
+            for (int h = -s; h <= s; h++) {
+                filterRowIndex = (h + s) * filterWidth;
+                sourceImgRowIndex = (h + l) * paddedWidth;
+                for (int w = -s; w <= s; w++) {
+                    pixelSum += data.mask[(w + s) + filterRowIndex] * 
+                                    data.paddedImage[w + j + sourceImgRowIndex];
+                }
+            }
+            if (pixelSum < 0) {
+                pixelSum = 0;
+            }
+            else if (pixelSum > 255) {
+                pixelSum = 255;
+            }
+            data.outImage[(j - s) + outImgRowIndex] = pixelSum;
+            pixelSum = 0;
+        }
+    }
+}
+
+void convVectorized(const ConvData& data, int startLine, int stopLine, 
+                    int startColumn, int stopColumn)
+{
+    std::vector<float> accumulator(stopColumn - startColumn);
+    convVectorized(data, startLine, stopLine, startColumn, stopColumn, accumulator.data());
+}
+
+void convVectorized(const ConvData& data, int startLine, int stopLine, 
+                    int startColumn, int stopColumn, float* accumulator)
+{
+    int filterWidth = data.filterWidth;
+    int paddedWidth = data.width + floor(filterWidth / 2) * 2;
+    int regionWidth = stopColumn - startColumn;
+
+    // Every tap is accumulated over the whole row: the inner loops have
+    // unit stride and no dependencies, so the compiler vectorizes them.
+    // Taps are summed in the same order as convDirect.
+    float* __restrict__ sum = accumulator;
+
+    for (int l = startLine; l < stopLine; l++) {
+        std::fill(sum, sum + regionWidth, 0.0f);
+        for (int h = 0; h < filterWidth; h++) {
+            const float* sourceRow = data.paddedImage + (l + h) * paddedWidth + startColumn;
+            for (int w = 0; w < filterWidth; w++) {
+                const float coefficient = data.mask[w + h * filterWidth];
+                const float* __restrict__ source = sourceRow + w;
+                for (int x = 0; x < regionWidth; x++) {
+                    sum[x] += coefficient * source[x];
+                }
+            }
+        }
+
+        float* __restrict__ outRow = data.outImage + l * data.width + startColumn;
+        for (int x = 0; x < regionWidth; x++) {
+            outRow[x] = std::min(std::max(sum[x], 0.0f), 255.0f);
+        }
+    }
+}
+
+void convSeparable(const ConvData& data, int startLine, int stopLine, 
+                    int startColumn, int stopColumn)
+{
+    int regionWidth = stopColumn - startColumn;
+    int regionHeight = stopLine - startLine + data.filterWidth - 1;
+    std::vector<float> rowPass(regionWidth * regionHeight);
+    convSeparable(data, startLine, stopLine, startColumn, stopColumn, rowPass.data());
+}
+
+void convSeparable(const ConvData& data, int startLine, int stopLine, 
+                    int startColumn, int stopColumn, float* rowPass)
+{
+    int filterWidth = data.filterWidth;
+    int paddedWidth = data.width + floor(filterWidth / 2) * 2;
+    int regionWidth = stopColumn - startColumn;
+    int regionHeight = stopLine - startLine + filterWidth - 1;
+
+    // Horizontal pass on the region rows plus the vertical halo
+    std::fill(rowPass, rowPass + regionWidth * regionHeight, 0.0f);
+    for (int r = 0; r < regionHeight; r++) {
+        const float* sourceRow = data.paddedImage + (startLine + r) * paddedWidth + startColumn;
+        float* __restrict__ passRow = rowPass + r * regionWidth;
+        for (int w = 0; w < filterWidth; w++) {
+            const float coefficient = data.rowFilter[w];
+            const float* __restrict__ source = sourceRow + w;
+            for (int x = 0; x < regionWidth; x++) {
+                passRow[x] += coefficient * source[x];
+            }
+        }
+    }
+
+    // Vertical pass straight into the output rows
+    for (int l = startLine; l < stopLine; l++) {
+        float* __restrict__ outRow = data.outImage + l * data.width + startColumn;
+        std::fill(outRow, outRow + regionWidth, 0.0f);
+        for (int h = 0; h < filterWidth; h++) {
+            const float coefficient = data.columnFilter[h];
+            const float* __restrict__ passRow = rowPass + (l - startLine + h) * regionWidth;
+            for (int x = 0; x < regionWidth; x++) {
+                outRow[x] += coefficient * passRow[x];
+            }
+        }
+        for (int x = 0; x < regionWidth; x++) {
+            outRow[x] = std::min(std::max(outRow[x], 0.0f), 255.0f);
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include <atomic>
+
+
+/*
+ * @brief: Data shared by the convolution threads
+ */
+struct ConvData
+{
+    const float* paddedImage;       ///< Replicate padded source matrix
+    float* outImage;                ///< Output matrix
+    int width;                      ///< Output width
+    int height;                     ///< Output height
+    int filterWidth;                ///< Kernel side
+    const float* mask;              ///< Linearized kernel
+    const float* columnFilter;      ///< Vertical 1D filter, separable kernels only
+    const float* rowFilter;         ///< Horizontal 1D filter, separable kernels only
+};
+
+/*
+ * @brief: Convolution of the output region [startLine, stopLine) x [startColumn, stopColumn)
+ */
+typedef void (*RegionConv)(const ConvData& data, int startLine, int stopLine,
+                            int startColumn, int stopColumn);
+
+void convDirect(const ConvData& data, int startLine, int stopLine, 
+                int startColumn, int stopColumn);
+
+void convVectorized(const ConvData& data, int startLine, int stopLine, 
+                    int startColumn, int stopColumn);
+
+/*
+ * @brief: convVectorized accumulating in a caller buffer of
+ *          stopColumn - startColumn values, it does not allocate
+ */
+void convVectorized(const ConvData& data, int startLine, int stopLine, 
+                    int startColumn, int stopColumn, float* accumulator);
+
+void convSeparable(const ConvData& data, int startLine, int stopLine, 
+                    int startColumn, int stopColumn);
+
+/*
+ * @brief: convSeparable keeping the horizontal pass in a caller buffer of
+ *          (stopColumn - startColumn) x (stopLine - startLine + filterWidth - 1)
+ *          values, it does not allocate
+ */
+void convSeparable(const ConvData& data, int startLine, int stopLine, 
+                    int startColumn, int stopColumn, float* rowPass);
+
+void threadConvBand(RegionConv conv, const ConvData* data, int startLine, int stopLine);
+
+void threadConvTiles(RegionConv conv, const ConvData* data, int tileSize, std::atomic<int>* nextTile);
+
+/*
+ * @brief: source pixel (y, x) of the element (h, w) of the replicate
+ *          padded matrix, see Image::buildReplicatePaddedImage
+ */
+inline void getReplicateSource(int h, int w, int paddingHeight, int paddingWidth,
+                                int height, int width, int& y, int& x)
+{
+    int maxHImageBoundary = height - 1;
+    int maxWImageBoundary = width - 1;
+
+    if ((h < paddingHeight) && (w < paddingWidth)) {
+        y = 0;
+        x = 0;
+    }
+    else if ((h > maxHImageBoundary) && (w > maxWImageBoundary)) {
+        y = height - 1;
+        x = width - 1;
+    }
+    else if ((h < paddingHeight) && (w > maxWImageBoundary)) {
+        y = 0;
+        x = width - 1;
+    }
+    else if ((w < paddingWidth) && (h > maxHImageBoundary)) {
+        y = height - 1;
+        x = 0;
+    }
+    else if (h < paddingHeight) {
+        y = 0;
+        x = w;
+    }
+    else if (w < paddingWidth) {
+        y = h;
+        x = 0;
+    }
+    else if (h > maxHImageBoundary) {
+        y = height - 1;
+        x = w;
+    }
+    else if (w > maxWImageBoundary) {
+        y = h;
+        x = width - 1;
+    }
+    else {
+        y = h - paddingHeight;
+        x = w - paddingWidth;
+    }
+}
+
+#endif
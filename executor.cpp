@@ -0,0 +1,219 @@
+#include <iostream>
+#include "executor.h"
+
+
+Job::Job(std::function<bool()> task, Executor* executor) :
+    m_task(task), m_executor(executor), m_status(JobStatus::PENDING)
+{
+    m_future = m_promise.get_future().share();
+}
+
+JobStatus Job::getStatus() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_status;
+}
+
+bool Job::wait() const
+{
+    return m_future.get();
+}
+
+std::shared_future<bool> Job::getFuture() const
+{
+    return m_future;
+}
+
+bool Job::cancel()
+{
+    // A queued job is skipped by the worker once cancelled
+    if (finish(JobStatus::CANCELLED, true)) {
+        return true;
+    }
+
+    return getStatus() == JobStatus::CANCELLED;
+}
+
+void Job::onComplete(std::function<void(JobStatus)> callback)
+{
+    JobStatus status;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        status = m_status;
+        if (status == JobStatus::PENDING || status == JobStatus::RUNNING) {
+            m_callbacks.push_back(callback);
+            return;
+        }
+    }
+
+    callback(status);
+}
+
+void Job::addDependent(const std::shared_ptr<Job>& dependent)
+{
+    JobStatus status;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        status = m_status;
+        if (status == JobStatus::PENDING || status == JobStatus::RUNNING) {
+            m_dependents.push_back(dependent);
+            return;
+        }
+    }
+
+    if (status == JobStatus::COMPLETED) {
+        m_executor->post(dependent);
+    }
+    else {
+        dependent->finish(JobStatus::CANCELLED, true);
+    }
+}
+
+void Job::run()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_status != JobStatus::PENDING) {
+            return;
+        }
+        m_status = JobStatus::RUNNING;
+    }
+
+    bool result = false;
+    try {
+        result = m_task();
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Job failed: " << e.what() << std::endl;
+        result = false;
+    }
+    catch (...) {
+        std::cerr << "Job failed: unknown exception" << std::endl;
+        result = false;
+    }
+
+    // Release captured state as soon as possible
+    m_task = std::function<bool()>();
+
+    finish(result ? JobStatus::COMPLETED : JobStatus::FAILED);
+}
+
+bool Job::finish(JobStatus status, bool pendingOnly)
+{
+    std::vector<std::shared_ptr<Job>> dependents;
+    std::vector<std::function<void(JobStatus)>> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_status == JobStatus::COMPLETED || m_status == JobStatus::FAILED ||
+                m_status == JobStatus::CANCELLED) {
+            return false;
+        }
+        if (pendingOnly && m_status != JobStatus::PENDING) {
+            return false;
+        }
+        m_status = status;
+        dependents.swap(m_dependents);
+        callbacks.swap(m_callbacks);
+    }
+
+    for (unsigned int i = 0; i < dependents.size(); i++) {
+        if (status == JobStatus::COMPLETED) {
+            m_executor->post(dependents[i]);
+        }
+        else {
+            dependents[i]->finish(JobStatus::CANCELLED, true);
+        }
+    }
+
+    // A throwing callback must not keep the waiters blocked
+    for (unsigned int i = 0; i < callbacks.size(); i++) {
+        try {
+            callbacks[i](status);
+        }
+        catch (...) {
+            std::cerr << "Job completion callback failed" << std::endl;
+        }
+    }
+
+    // Waiters are released once callbacks have run
+    m_promise.set_value(status == JobStatus::COMPLETED);
+
+    return true;
+}
+
+Executor::Executor(int threadsNumber) :
+    m_stopping(false)
+{
+    if (threadsNumber <= 0) {
+        threadsNumber = 1;
+    }
+
+    for (int i = 0; i < threadsNumber; i++) {
+        m_threads.push_back(std::thread(&Executor::workerLoop, this));
+    }
+}
+
+Executor::~Executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (unsigned int i = 0; i < m_threads.size(); i++) {
+        m_threads[i].join();
+    }
+}
+
+std::shared_ptr<Job> Executor::submit(std::function<bool()> task, std::shared_ptr<Job> dependency)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>(task, this);
+
+    if (dependency) {
+        dependency->addDependent(job);
+    }
+    else {
+        post(job);
+    }
+
+    return job;
+}
+
+int Executor::getThreadsNumber() const
+{
+    return m_threads.size();
+}
+
+Executor& Executor::getShared()
+{
+    static Executor sharedExecutor(std::thread::hardware_concurrency());
+    return sharedExecutor;
+}
+
+void Executor::post(const std::shared_ptr<Job>& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(job);
+    }
+    m_condition.notify_one();
+}
+
+void Executor::workerLoop()
+{
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            job = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        job->run();
+    }
+}
@@ -0,0 +1,156 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+
+enum class JobStatus
+{
+    PENDING,
+    RUNNING,
+    COMPLETED,
+    FAILED,
+    CANCELLED
+};
+
+class Executor;
+
+/*
+ * @brief: Handle of an operation submitted to an Executor
+ */
+class Job
+{
+    public:
+        Job(std::function<bool()> task, Executor* executor);
+
+        /*
+         * @brief: return the current job status
+         */
+        JobStatus getStatus() const;
+
+        /*
+         * @brief: block until the job has finished
+         *
+         * @return: true if the job completed successfully, false otherwise
+         */
+        bool wait() const;
+
+        /*
+         * @brief: return a future set to the job result once finished.
+         *          Cancelled jobs set it to false.
+         */
+        std::shared_future<bool> getFuture() const;
+
+        /*
+         * @brief: cancel the job if it has not started yet. Jobs
+         *          depending on it are cancelled too.
+         *
+         * @return: true if the job will not run, false otherwise
+         */
+        bool cancel();
+
+        /*
+         * @brief: register a callback invoked with the final status once
+         *          the job has finished. If it has already finished, the
+         *          callback is invoked immediately in the calling thread.
+         *
+         * @params[in]: callback: the function to be invoked
+         */
+        void onComplete(std::function<void(JobStatus)> callback);
+
+    private:
+        friend class Executor;
+
+        /*
+         * @brief: schedule dependent to run after this job
+         */
+        void addDependent(const std::shared_ptr<Job>& dependent);
+
+        /*
+         * @brief: run the task if the job is still pending
+         */
+        void run();
+
+        /*
+         * @brief: set the final status and release dependents and callbacks
+         *
+         * @params[in]: status: the final status
+         * @params[in]: pendingOnly: only finish a job that has not started
+         * @return: true if the status has been set, false otherwise
+         */
+        bool finish(JobStatus status, bool pendingOnly = false);
+
+        std::function<bool()> m_task;                           ///< Operation to be executed
+        Executor* m_executor;                                   ///< Executor running the job and its dependents
+        JobStatus m_status;                                     ///< Current job status
+        std::promise<bool> m_promise;                           ///< Promise set when the job finishes
+        std::shared_future<bool> m_future;                      ///< Future bound to m_promise
+        std::vector<std::shared_ptr<Job>> m_dependents;         ///< Jobs waiting for this one
+        std::vector<std::function<void(JobStatus)>> m_callbacks;///< Completion callbacks
+        mutable std::mutex m_mutex;                             ///< Protects job state
+};
+
+/*
+ * @brief: A fixed size pool of threads running submitted jobs
+ */
+class Executor
+{
+    public:
+        explicit Executor(int threadsNumber);
+
+        /*
+         *  @brief: Dtor. Waits for queued jobs to be executed
+         */
+        ~Executor();
+
+        /*
+         * @brief: submit a task. The task returns true on success.
+         *
+         * @params[in]: task: the function to be executed
+         * @params[in]: dependency: (optional) job that must complete successfully
+         *              before the task is run. If it fails or it is cancelled,
+         *              the new job is cancelled. No thread waits meanwhile.
+         * @return: the job handle
+         */
+        std::shared_ptr<Job> submit(std::function<bool()> task,
+                                    std::shared_ptr<Job> dependency = nullptr);
+
+        /*
+         * @brief: return the number of pool threads
+         */
+        int getThreadsNumber() const;
+
+        /*
+         * @brief: return the executor shared by the asynchronous Image operations,
+         *          with one thread per hardware thread
+         */
+        static Executor& getShared();
+
+    private:
+        friend class Job;
+
+        /*
+         * @brief: enqueue a job ready to be run
+         */
+        void post(const std::shared_ptr<Job>& job);
+
+        /*
+         * @brief: pool threads loop
+         */
+        void workerLoop();
+
+        std::vector<std::thread> m_threads;             ///< Pool threads
+        std::deque<std::shared_ptr<Job>> m_queue;       ///< Jobs ready to be run
+        std::mutex m_mutex;                             ///< Protects the queue
+        std::condition_variable m_condition;            ///< Signals new jobs or stop
+        bool m_stopping;                                ///< Set by the destructor
+};
+
+#endif
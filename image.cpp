@@ -1,20 +1,148 @@
-#include <png++/png.hpp>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
 #include <math.h>
+#include <atomic>
 #include "image.h"
+#include "tuner.h"
+#include "convolution.h"
 
 
-void threadConv(const float* sourceImage, 
-                int startLine, int stopLine,
-                float* outImage, 
-                const float* mask,
-                int width, int height, int channels, 
-                int filterWidth);
+/*
+ * @brief: Rows of a pyramid level produced by a thread: its owned rows,
+ *          written to the level image, plus the halo rows needed by its
+ *          rows of the next level. Only the last rows are kept, in a ring.
+ */
+struct PyramidLevelRows
+{
+    std::vector<float> ring;                ///< Last rows produced, row y at y % capacity
+    std::vector<const float*> window;       ///< Source rows of the row being produced
+    int capacity;                           ///< Rows in the ring
+    int nextLine;                           ///< Next row to be produced
+    int stopLine;                           ///< Rows [nextLine, stopLine) are still to be produced
+    int startOwned;                         ///< First row written to the level image
+    int stopOwned;                          ///< Rows [startOwned, stopOwned) are written
+};
+
+void threadPyramid(const std::vector<float*>& levels,
+                    const std::vector<int>& widths, 
+                    const std::vector<int>& heights,
+                    int threadIndex, int threadsNumber,
+                    const float* mask, int filterWidth);
+
+/*
+ * @brief: Blocks of TILED source and output matrices
+ */
+struct BlockData
+{
+    const float* source;            ///< TILED source matrix
+    float* outImage;                ///< TILED output matrix
+    int width;                      ///< Image width
+    int height;                     ///< Image height
+    int blockSize;                  ///< Block side
+    int blocksPerRow;               ///< Blocks in a row of blocks
+    int blocksNumber;               ///< Blocks in the image
+    int filterWidth;                ///< Kernel side
+    const float* mask;              ///< Linearized kernel
+    const float* columnFilter;      ///< Vertical 1D filter, separable kernels only
+    const float* rowFilter;         ///< Horizontal 1D filter, separable kernels only
+};
+
+void threadConvBlocks(RegionConv conv, const BlockData* data, std::atomic<int>* nextBlock);
+
+/*
+ * @brief: index of pixel (y, x) in a TILED matrix
+ */
+static inline int getBlockIndex(int y, int x, int blockSize, int blocksPerRow)
+{
+    return ((y / blockSize) * blocksPerRow + x / blockSize) * blockSize * blockSize +
+            (y % blockSize) * blockSize + x % blockSize;
+}
+
+/*
+ * @brief: reorder a row-major matrix in blocks. Blocks on the right and
+ *          bottom borders are stored whole, their outer part set to 0
+ */
+static std::vector<float> convertToTiled(const std::vector<float>& source, int width, int height,
+                                            int blockSize)
+{
+    int blocksPerRow = (width + blockSize - 1) / blockSize;
+    int blocksPerColumn = (height + blockSize - 1) / blockSize;
+    std::vector<float> tiled(blocksPerRow * blocksPerColumn * blockSize * blockSize, 0.0f);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x += blockSize) {
+            int length = std::min(blockSize, width - x);
+            std::copy(source.begin() + y * width + x, source.begin() + y * width + x + length,
+                        tiled.begin() + getBlockIndex(y, x, blockSize, blocksPerRow));
+        }
+    }
+
+    return tiled;
+}
+
+static std::vector<float> convertToRowMajor(const std::vector<float>& tiled, int width, int height,
+                                            int blockSize)
+{
+    int blocksPerRow = (width + blockSize - 1) / blockSize;
+    std::vector<float> source(width * height);
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x += blockSize) {
+            int length = std::min(blockSize, width - x);
+            int index = getBlockIndex(y, x, blockSize, blocksPerRow);
+            std::copy(tiled.begin() + index, tiled.begin() + index + length,
+                        source.begin() + y * width + x);
+        }
+    }
+
+    return source;
+}
 
-Image::Image()
+/*
+ * @brief: copy the padded input of the block starting at (startLine,
+ *          startColumn), halo included, in a (blockSize + filterWidth - 1)
+ *          side square
+ */
+static void gatherBlockHalo(const BlockData& data, int startLine, int startColumn, float* halo)
 {
-    m_threads = std::vector<std::thread>();
+    int s = data.filterWidth / 2;
+    int haloSize = data.blockSize + data.filterWidth - 1;
+
+    for (int i = 0; i < haloSize; i++) {
+        int h = startLine + i;
+        float* haloRow = halo + i * haloSize;
+
+        // Rows inside the image are copied by block segments
+        bool inside = h >= s && h < data.height && startColumn >= s &&
+                        startColumn + haloSize <= data.width;
+        if (inside) {
+            int y = h - s;
+            for (int j = 0; j < haloSize; ) {
+                int x = startColumn + j - s;
+                int length = std::min(haloSize - j, data.blockSize - x % data.blockSize);
+                const float* source = data.source + getBlockIndex(y, x, data.blockSize, data.blocksPerRow);
+                std::copy(source, source + length, haloRow + j);
+                j += length;
+            }
+            continue;
+        }
+
+        // Border rows follow the padding replication
+        for (int j = 0; j < haloSize; j++) {
+            int y = 0;
+            int x = 0;
+            getReplicateSource(h, startColumn + j, s, s, data.height, data.width, y, x);
+            haloRow[j] = data.source[getBlockIndex(y, x, data.blockSize, data.blocksPerRow)];
+        }
+    }
 }
 
+Image::Image() :
+    m_imageWidth(0), m_imageHeight(0), 
+    m_layout(ImageLayout::ROW_MAJOR), m_blockSize(IMAGE_DEFAULT_BLOCK_SIZE)
+{}
+
 int Image::getImageWidth() const
 {
     return m_imageWidth;
@@ -33,7 +161,26 @@ int Image::getImageChannels() const
 
 bool Image::setImage(const std::vector<float>& source, int width, int height)
 {
-    this->m_image = source;
+    if (m_layout == ImageLayout::TILED) {
+        this->m_image = convertToTiled(source, width, height, m_blockSize);
+    }
+    else {
+        this->m_image = source;
+    }
+    this->m_imageWidth = width;
+    this->m_imageHeight = height;
+
+    return true;
+}
+
+bool Image::setImage(std::vector<float>&& source, int width, int height)
+{
+    if (m_layout == ImageLayout::TILED) {
+        this->m_image = convertToTiled(source, width, height, m_blockSize);
+    }
+    else {
+        this->m_image.swap(source);
+    }
     this->m_imageWidth = width;
     this->m_imageHeight = height;
 
@@ -42,49 +189,88 @@ bool Image::setImage(const std::vector<float>& source, int width, int height)
 
 std::vector<float> Image::getImage() const
 {
+    if (m_layout == ImageLayout::TILED) {
+        return convertToRowMajor(m_image, m_imageWidth, m_imageHeight, m_blockSize);
+    }
     return this->m_image;
 }
 
-bool Image::loadImage(const char *filename)
+const float* Image::getData() const
 {
-    // Load image
-    png::image<png::gray_pixel> image(filename);
+    return this->m_image.data();
+}
 
-    // Build matrix from image    
-    m_imageHeight = image.get_height();
-    m_imageWidth = image.get_width();
-    std::vector<float> imageMatrix(m_imageHeight * m_imageWidth);
-    
-    for (unsigned int h = 0; h < image.get_height(); h++) {
-        for (unsigned int w = 0; w < image.get_width(); w++) {
-            imageMatrix[w + h * m_imageWidth] = image[h][w];
-            //imageMatrix[1][h][w] = image[h][w].green;
-            //imageMatrix[2][h][w] = image[h][w].blue;
-        }
+bool Image::setLayout(ImageLayout layout, int blockSize)
+{
+    if (layout == ImageLayout::TILED && blockSize <= 0) {
+        std::cerr << "Invalid block size" << std::endl;
+        return false;
+    }
+
+    std::vector<float> source = getImage();
+    m_layout = layout;
+    m_blockSize = blockSize;
+    setImage(source, m_imageWidth, m_imageHeight);
+
+    return true;
+}
+
+ImageLayout Image::getLayout() const
+{
+    return m_layout;
+}
+
+int Image::getBlockSize() const
+{
+    return m_blockSize;
+}
+
+bool Image::loadImage(const char *filename)
+{
+    // Rows are decoded straight into the matrix
+    std::vector<float> imageMatrix;
+    int width = 0;
+    int height = 0;
+    if (!readGrayPng(filename, imageMatrix, width, height)) {
+        return false;
     }
 
-    m_image = imageMatrix;
+    m_imageHeight = height;
+    m_imageWidth = width;
+    if (m_layout == ImageLayout::TILED) {
+        m_image = convertToTiled(imageMatrix, width, height, m_blockSize);
+    }
+    else {
+        m_image.swap(imageMatrix);
+    }
 
     return true;
 }
 
 bool Image::saveImage(const char *filename) const
 {
-    int height = this->getImageHeight();
-    int width = this->getImageWidth();
+    return this->saveImage(filename, PngSettings());
+}
 
-    png::image<png::gray_pixel> imageFile(width, height);
+bool Image::saveImage(const char *filename, const PngSettings& settings) const
+{
+    auto t1 = std::chrono::high_resolution_clock::now();
 
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            imageFile[y][x] = m_image[x + y * width];
-            //imageFile[y][x].green = m_image[1][y][x];
-            //imageFile[y][x].blue = m_image[2][y][x];
-        }
+    // Blocks are put back in rows only for the encoder
+    std::vector<float> rowMajorImage;
+    if (m_layout == ImageLayout::TILED) {
+        rowMajorImage = getImage();
     }
-    imageFile.write(filename);
+    const float* pixels = m_layout == ImageLayout::TILED ? rowMajorImage.data() : m_image.data();
 
-    std::cout << "Image saved in " << std::string(filename) << std::endl;
+    if (!writeGrayPng(filename, pixels, m_imageWidth, m_imageHeight, settings)) {
+        return false;
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto encodingDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+
+    std::cout << "Image saved in " << std::string(filename) 
+              << " (encoding time: " << encodingDuration << " μs)" << std::endl;
 
     return true;
 }
@@ -202,12 +388,20 @@ std::vector<float> Image::applyFilterCommon(const Kernel& kernel) const
     return newImage;
 }
 
-bool Image::multithreadFiltering(Image& resultingImage, const Kernel& kernel, int threadsNumber)
+bool Image::multithreadFiltering(Image& resultingImage, const Kernel& kernel, int threadsNumber) const
+{
+    FilterOptions options;
+    options.threadsNumber = threadsNumber;
+
+    return multithreadFiltering(resultingImage, kernel, options);
+}
+
+bool Image::multithreadFiltering(Image& resultingImage, const Kernel& kernel, 
+                                    const FilterOptions& options) const
 {
     std::cout << "Applying multithread filter to image" << std::endl;
 
     // Get image dimensions
-    int channels = this->getImageChannels();
     int height = this->getImageHeight();
     int width = this->getImageWidth();
 
@@ -215,6 +409,87 @@ bool Image::multithreadFiltering(Image& resultingImage, const Kernel& kernel, in
     int filterHeight = kernel.getKernelHeight();
     int filterWidth = kernel.getKernelWidth();
 
+    if (filterHeight == 0 || filterWidth == 0) {
+        std::cerr << "Invalid filter dimension" << std::endl;
+        return false;
+    }
+
+    // Fill automatic options from the tuning profile
+    FilterOptions resolved = Tuner::resolveOptions(options, kernel, width, height);
+    int threadsNumber = resolved.threadsNumber;
+
+    std::vector<float> columnFilter;
+    std::vector<float> rowFilter;
+    if (resolved.algorithm == FilterAlgorithm::SEPARABLE && 
+            !kernel.getSeparableFilters(columnFilter, rowFilter)) {
+        std::cerr << "Kernel is not separable, using direct convolution" << std::endl;
+        resolved.algorithm = FilterAlgorithm::DIRECT;
+    }
+
+    std::cout << "Algorithm: " << Tuner::getAlgorithmName(resolved.algorithm);
+    if (m_layout == ImageLayout::TILED) {
+        std::cout << ", layout: tiled " << m_blockSize;
+    }
+    else {
+        std::cout << ", partition: " << Tuner::getPartitionName(resolved.partition);
+        if (resolved.partition == FilterPartition::TILES) {
+            std::cout << " " << resolved.tileSize;
+        }
+    }
+    std::cout << ", threads: " << threadsNumber << std::endl;
+
+    RegionConv conv = convDirect;
+    if (resolved.algorithm == FilterAlgorithm::VECTORIZED) {
+        conv = convVectorized;
+    }
+    else if (resolved.algorithm == FilterAlgorithm::SEPARABLE) {
+        conv = convSeparable;
+    }
+
+    if (m_layout == ImageLayout::TILED) {
+        // Blocks are the work units, each one convolved from its halo
+        std::vector<float> mask = kernel.getKernel();
+        std::vector<float> newImage(m_image.size(), 0.0f);
+
+        BlockData data;
+        data.source = m_image.data();
+        data.outImage = newImage.data();
+        data.width = width;
+        data.height = height;
+        data.blockSize = m_blockSize;
+        data.blocksPerRow = (width + m_blockSize - 1) / m_blockSize;
+        data.blocksNumber = data.blocksPerRow * ((height + m_blockSize - 1) / m_blockSize);
+        data.filterWidth = filterWidth;
+        data.mask = mask.data();
+        data.columnFilter = columnFilter.data();
+        data.rowFilter = rowFilter.data();
+
+        std::atomic<int> nextBlock(0);
+        std::vector<std::thread> threads;
+
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (int i = 1; i < std::min(threadsNumber, data.blocksNumber); i++) {
+            threads.push_back(std::thread(threadConvBlocks, conv, &data, &nextBlock));
+        }
+        threadConvBlocks(conv, &data, &nextBlock);
+        for (unsigned int i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        auto filterDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+        std::cout << "Multithread filtering execution time: " << filterDuration << " μs" << std::endl;
+
+        resultingImage.m_image.swap(newImage);
+        resultingImage.m_imageWidth = width;
+        resultingImage.m_imageHeight = height;
+        resultingImage.m_layout = ImageLayout::TILED;
+        resultingImage.m_blockSize = m_blockSize;
+
+        std::cout << "Done!" << std::endl;
+
+        return true;
+    }
+
     // Input padding w.r.t. filter size
     auto t1 = std::chrono::high_resolution_clock::now();
     std::vector<float> paddedImage = buildReplicatePaddedImage(floor(filterHeight / 2), floor(filterWidth / 2));
@@ -228,15 +503,38 @@ bool Image::multithreadFiltering(Image& resultingImage, const Kernel& kernel, in
     std::vector<float> mask = kernel.getKernel();
 
     // Use pointers to speed up pixels access
-    const float* maskPtr = {mask.data()};
-    const float* paddedImagePtr = {paddedImage.data()};
-    float* outImagePtr = {newImage.data()};
-    
+    ConvData data;
+    data.paddedImage = paddedImage.data();
+    data.outImage = newImage.data();
+    data.width = width;
+    data.height = height;
+    data.filterWidth = filterWidth;
+    data.mask = mask.data();
+    data.columnFilter = columnFilter.data();
+    data.rowFilter = rowFilter.data();
+
     int startLine = 0;
     int stopLine = 0;
+    std::atomic<int> nextTile(0);
+
+    // Threads are local, so that jobs can filter the same image concurrently
+    std::vector<std::thread> threads;
 
     t1 = std::chrono::high_resolution_clock::now();
+
+    // A single thread runs in the caller, e.g. a pool thread of a job
+    if (threadsNumber == 1) {
+        threadConvBand(conv, &data, 0, height);
+        threadsNumber = 0;
+    }
+
     for (int i = 0; i < threadsNumber; i++) {
+        if (resolved.partition == FilterPartition::TILES) {
+            threads.push_back(std::thread(threadConvTiles, conv, &data, 
+                                resolved.tileSize, &nextTile));
+            continue;
+        }
+
         // If more thread than images row are requested
         if (i > height) {
             break;
@@ -260,15 +558,12 @@ bool Image::multithreadFiltering(Image& resultingImage, const Kernel& kernel, in
         }
 
         // Create threads and assign to them 
-        // the threadConv function
-        m_threads.push_back(std::thread(threadConv, paddedImagePtr, 
-                                startLine, stopLine, outImagePtr, maskPtr, 
-                                width, height, channels, filterWidth));          
+        // the band convolution function
+        threads.push_back(std::thread(threadConvBand, conv, &data, startLine, stopLine));
     }
 
-    // Once joined, threads will be removed from the vector
-    for (unsigned int i = 0; i < m_threads.size(); i++) {
-        m_threads[i].join();
+    for (unsigned int i = 0; i < threads.size(); i++) {
+        threads[i].join();
     }
     t2 = std::chrono::high_resolution_clock::now();
     auto filterDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
@@ -285,100 +580,309 @@ bool Image::multithreadFiltering(Image& resultingImage, const Kernel& kernel, in
     return true;
 }
 
-void threadConv(const float* sourceImage, 
-                int startLine, int stopLine, 
-                float* outImage, 
-                const float* mask,
-                int width, int height, int channels, 
-                int filterWidth)
+void threadConvBlocks(RegionConv conv, const BlockData* data, std::atomic<int>* nextBlock)
 {
-    int paddedWidth = width + floor(filterWidth / 2) * 2;
-    int s = floor(filterWidth / 2);
+    int blockSize = data->blockSize;
+    int haloSize = blockSize + data->filterWidth - 1;
+    std::vector<float> halo(haloSize * haloSize);
+
+    // The block is the whole image of the region convolution:
+    // the output rows stride is the block side
+    ConvData blockData;
+    blockData.paddedImage = halo.data();
+    blockData.width = blockSize;
+    blockData.height = blockSize;
+    blockData.filterWidth = data->filterWidth;
+    blockData.mask = data->mask;
+    blockData.columnFilter = data->columnFilter;
+    blockData.rowFilter = data->rowFilter;
+
+    for (int b = nextBlock->fetch_add(1); b < data->blocksNumber; b = nextBlock->fetch_add(1)) {
+        int startLine = (b / data->blocksPerRow) * blockSize;
+        int startColumn = (b % data->blocksPerRow) * blockSize;
+
+        gatherBlockHalo(*data, startLine, startColumn, halo.data());
+        blockData.outImage = data->outImage + b * blockSize * blockSize;
+        conv(blockData, 0, std::min(blockSize, data->height - startLine),
+                0, std::min(blockSize, data->width - startColumn));
+    }
+}
 
-    int filterRowIndex = 0;
-    int sourceImgRowIndex = 0;
-    int outImgRowIndex = 0;
+std::shared_ptr<Job> Image::submitLoad(const char *filename, std::shared_ptr<Job> dependency)
+{
+    std::string path(filename);
+
+    return Executor::getShared().submit([this, path]() {
+        return this->loadImage(path.c_str());
+    }, dependency);
+}
+
+std::shared_ptr<Job> Image::submitFilter(Image& resultingImage, const Kernel& kernel,
+                                            const FilterOptions& options,
+                                            std::shared_ptr<Job> dependency) const
+{
+    Image* result = &resultingImage;
+
+    return Executor::getShared().submit([this, result, kernel, options]() {
+        return this->multithreadFiltering(*result, kernel, options);
+    }, dependency);
+}
+
+std::shared_ptr<Job> Image::submitSave(const char *filename, const PngSettings& settings,
+                                        std::shared_ptr<Job> dependency) const
+{
+    std::string path(filename);
+
+    return Executor::getShared().submit([this, path, settings]() {
+        return this->saveImage(path.c_str(), settings);
+    }, dependency);
+}
+
+bool Image::buildGaussianPyramid(std::vector<Image*>& levels, const Kernel& kernel, int threadsNumber) const
+{
+    std::cout << "Building gaussian pyramid" << std::endl;
+
+    int filterHeight = kernel.getKernelHeight();
+    int filterWidth = kernel.getKernelWidth();
+
+    if (filterHeight == 0 || filterWidth != filterHeight || filterWidth % 2 == 0) {
+        std::cerr << "Invalid filter dimension" << std::endl;
+        return false;
+    }
+
+    if (levels.empty() || threadsNumber <= 0) {
+        std::cerr << "Invalid pyramid parameters" << std::endl;
+        return false;
+    }
+
+    // Evaluate levels dimensions: level 0 is the source image
+    std::vector<int> widths(1, m_imageWidth);
+    std::vector<int> heights(1, m_imageHeight);
+    for (unsigned int l = 0; l < levels.size(); l++) {
+        if (widths[l] < 2 || heights[l] < 2) {
+            std::cerr << "Too many pyramid levels for image size" << std::endl;
+            return false;
+        }
+        widths.push_back((widths[l] + 1) / 2);
+        heights.push_back((heights[l] + 1) / 2);
+    }
+
+    std::vector<std::vector<float>> levelImages(levels.size());
+    std::vector<float> rowMajorImage;
+    if (m_layout == ImageLayout::TILED) {
+        rowMajorImage = getImage();
+    }
+    const float* sourceImage = m_layout == ImageLayout::TILED ? rowMajorImage.data() : m_image.data();
+    std::vector<float*> levelPtrs(1, const_cast<float*>(sourceImage));
+    for (unsigned int l = 0; l < levels.size(); l++) {
+        levelImages[l].resize(widths[l + 1] * heights[l + 1]);
+        levelPtrs.push_back(levelImages[l].data());
+    }
+
+    std::vector<float> mask = kernel.getKernel();
+
+    std::vector<std::thread> threads;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < threadsNumber; i++) {
+        threads.push_back(std::thread(threadPyramid, std::cref(levelPtrs), 
+                                std::cref(widths), std::cref(heights),
+                                i, threadsNumber, mask.data(), filterWidth));
+    }
+
+    for (unsigned int i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto pyramidDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    std::cout << "Pyramid execution time: " << pyramidDuration << " μs" << std::endl;
+
+    for (unsigned int l = 0; l < levels.size(); l++) {
+        levels[l]->setImage(levelImages[l], widths[l + 1], heights[l + 1]);
+    }
+
+    std::cout << "Done!" << std::endl;
+
+    return true;
+}
+
+/*
+ * @brief: produce the rows of level l up to lastLine, producing first the
+ *          rows of the previous level they need. Rows of level 0 are read
+ *          from the source image.
+ */
+static void producePyramidRows(int l, int lastLine, std::vector<PyramidLevelRows>& rows,
+                                const std::vector<float*>& levels, const std::vector<int>& widths,
+                                const std::vector<int>& heights, const float* mask, int filterWidth)
+{
+    PyramidLevelRows& level = rows[l];
+    int s = floor(filterWidth / 2);
+    int sourceWidth = widths[l - 1];
+    int sourceHeight = heights[l - 1];
+    int outWidth = widths[l];
     float pixelSum = 0.0f;
 
-    // Apply convolution
-    for (int d = 0; d < channels; d++) {
-        for (int l = startLine + s; l < stopLine + s; l++) {
-            outImgRowIndex = (l - s) * width;
-            for (int j = s; j < width + s; j++) {
-                for (int h = -s; h <= s; h++) {
-                    filterRowIndex = (h + s) * filterWidth;
-                    sourceImgRowIndex = (h + l) * paddedWidth;
+    for (; level.nextLine <= lastLine && level.nextLine < level.stopLine; level.nextLine++) {
+        int y = level.nextLine;
+
+        // Replicate border on rows
+        if (l > 1) {
+            producePyramidRows(l - 1, std::min(2 * y + s, sourceHeight - 1), rows, levels,
+                                widths, heights, mask, filterWidth);
+        }
+        for (int h = -s; h <= s; h++) {
+            int sourceY = std::min(std::max(2 * y + h, 0), sourceHeight - 1);
+            level.window[h + s] = l == 1 ? levels[0] + sourceY * sourceWidth :
+                                    rows[l - 1].ring.data() + (sourceY % rows[l - 1].capacity) * sourceWidth;
+        }
+
+        float* outRow = level.ring.data() + (y % level.capacity) * outWidth;
+        for (int x = 0; x < outWidth; x++) {
+            int sourceX = 2 * x;
+            bool interior = (sourceX - s >= 0) && (sourceX + s < sourceWidth);
+            for (int h = -s; h <= s; h++) {
+                const float* sourceRow = level.window[h + s];
+                const float* filterRow = mask + (h + s) * filterWidth;
+                if (interior) {
                     for (int w = -s; w <= s; w++) {
-                        pixelSum += mask[(w + s) + filterRowIndex] * 
-                                        sourceImage[w + j + sourceImgRowIndex];
+                        pixelSum += filterRow[w + s] * sourceRow[sourceX + w];
                     }
                 }
-                if (pixelSum < 0) {
-                    pixelSum = 0;
-                }
-                else if (pixelSum > 255) {
-                    pixelSum = 255;
+                else {
+                    for (int w = -s; w <= s; w++) {
+                        int c = std::min(std::max(sourceX + w, 0), sourceWidth - 1);
+                        pixelSum += filterRow[w + s] * sourceRow[c];
+                    }
                 }
-                outImage[(j - s) + outImgRowIndex] = pixelSum;
+            }
+            if (pixelSum < 0) {
                 pixelSum = 0;
             }
+            else if (pixelSum > 255) {
+                pixelSum = 255;
+            }
+            outRow[x] = pixelSum;
+            pixelSum = 0;
+        }
+
+        if (y >= level.startOwned && y < level.stopOwned) {
+            std::copy(outRow, outRow + outWidth, levels[l] + y * outWidth);
         }
     }
 }
 
+void threadPyramid(const std::vector<float*>& levels,
+                    const std::vector<int>& widths, 
+                    const std::vector<int>& heights,
+                    int threadIndex, int threadsNumber,
+                    const float* mask, int filterWidth)
+{
+    int s = floor(filterWidth / 2);
+    int levelsNumber = levels.size() - 1;
+    std::vector<PyramidLevelRows> rows(levels.size());
+
+    // Every thread owns a band of the last level and the bands twice as
+    // high of the finer levels, so the owned rows of every level are split
+    // among the threads. Halo rows of the neighbouring bands are computed
+    // again instead of waiting for other threads.
+    int startOwned = (heights[levelsNumber] * threadIndex) / threadsNumber;
+    int stopOwned = (heights[levelsNumber] * (threadIndex + 1)) / threadsNumber;
+    if (startOwned == stopOwned) {
+        return;
+    }
+
+    int startLine = startOwned;
+    int stopLine = stopOwned;
+    for (int l = levelsNumber; l >= 1; l--) {
+        PyramidLevelRows& level = rows[l];
+        level.capacity = 2 * s + 2;
+        level.ring.resize(level.capacity * widths[l]);
+        level.window.resize(2 * s + 1);
+        level.nextLine = startLine;
+        level.stopLine = stopLine;
+        level.startOwned = startOwned;
+        level.stopOwned = stopOwned;
+
+        int sourceHeight = heights[l - 1];
+        int requiredStart = std::max(2 * startLine - s, 0);
+        int requiredStop = std::min(2 * (stopLine - 1) + s, sourceHeight - 1) + 1;
+        startOwned = std::min(2 * startOwned, sourceHeight);
+        stopOwned = std::min(2 * stopOwned, sourceHeight);
+        startLine = std::min(requiredStart, startOwned);
+        stopLine = std::max(requiredStop, stopOwned);
+    }
+
+    // Rows flow level to level through the rings while they are in cache;
+    // then the owned rows not needed by the next level are completed
+    for (int l = levelsNumber; l >= 1; l--) {
+        producePyramidRows(l, rows[l].stopLine - 1, rows, levels, widths, heights, mask, filterWidth);
+    }
+}
+
 std::vector<float> Image::buildReplicatePaddedImage(const int paddingHeight,
                                                     const int paddingWidth) const
+{
+    int paddedHeight = this->getImageHeight() + paddingHeight * 2;
+    int paddedWidth = this->getImageWidth() + paddingWidth * 2;
+
+    std::vector<float> paddedImage(paddedHeight * paddedWidth);
+    buildReplicatePaddedImage(paddingHeight, paddingWidth, paddedImage.data());
+
+    //Image pImg;
+    //pImg.setImage(paddedImage, paddedWidth, paddedHeight);
+    //pImg.saveImage("padded.png");
+
+    return paddedImage;
+}
+
+void Image::buildReplicatePaddedImage(const int paddingHeight, const int paddingWidth,
+                                        float* paddedImage) const
 {
     int height = this->getImageHeight();
     int width = this->getImageWidth();
 
     int paddedHeight = height + paddingHeight * 2;
     int paddedWidth = width + paddingWidth * 2;
-    int maxHImageBoundary = height - 1;
-    int maxWImageBoundary = width - 1;
     int paddedImageRowIndex = 0;
 
-    std::vector<float> paddedImage(paddedHeight * paddedWidth);
-    std::vector<float> sourceImage = this->m_image;
+    // Row-major images are read in place
+    std::vector<float> rowMajorImage;
+    const float* sourceImage = m_image.data();
+    if (m_layout == ImageLayout::TILED) {
+        rowMajorImage = this->getImage();
+        sourceImage = rowMajorImage.data();
+    }
 
     for (int h = 0; h < paddedHeight; h++) {
         paddedImageRowIndex = h * paddedWidth;
         for (int w = 0; w < paddedWidth; w++) {
-            if ((h < paddingHeight) && (w < paddingWidth)) {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[0];
-            }
-            else if ((h > maxHImageBoundary) && (w > maxWImageBoundary)) {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[(width - 1) + (height - 1) * width];
-            }
-            else if ((h < paddingHeight) && (w > maxWImageBoundary)) {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[(width - 1) + (0) * width];
-            }
-            else if ((w < paddingWidth) && (h > maxHImageBoundary)) {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[(0) + (height - 1) * width];
-            }
-            else if (h < paddingHeight) {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[(w) + (0) * width];
-            }
-            else if (w < paddingWidth) {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[(0) + (h) * width];
-            }
-            else if (h > maxHImageBoundary) {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[(w) + (height - 1) * width];
-            }
-            else if (w > maxWImageBoundary) {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[(width - 1) + (h) * width];
-            }
-            else {
-                paddedImage[w + paddedImageRowIndex] = sourceImage[(w - paddingWidth) + (h - paddingHeight) * width];
-            }
+            int y = 0;
+            int x = 0;
+            getReplicateSource(h, w, paddingHeight, paddingWidth, height, width, y, x);
+            paddedImage[w + paddedImageRowIndex] = sourceImage[x + y * width];
         }
     }
+}
 
-    sourceImage.clear();
+std::vector<float> Image::buildClampedPaddedImage(const int paddingHeight,
+                                                    const int paddingWidth) const
+{
+    int height = this->getImageHeight();
+    int width = this->getImageWidth();
 
-    //Image pImg;
-    //pImg.setImage(paddedImage, paddedWidth, paddedHeight);
-    //pImg.saveImage("padded.png");
+    int paddedHeight = height + paddingHeight * 2;
+    int paddedWidth = width + paddingWidth * 2;
+
+    std::vector<float> paddedImage(paddedHeight * paddedWidth);
+    std::vector<float> sourceImage = this->getImage();
+
+    for (int h = 0; h < paddedHeight; h++) {
+        int y = std::min(std::max(h - paddingHeight, 0), height - 1);
+        for (int w = 0; w < paddedWidth; w++) {
+            int x = std::min(std::max(w - paddingWidth, 0), width - 1);
+            paddedImage[w + h * paddedWidth] = sourceImage[x + y * width];
+        }
+    }
 
     return paddedImage;
 }
@@ -396,7 +900,7 @@ std::vector<float> Image::buildZeroPaddingImage(const int paddingHeight,
     int paddedImageRowIndex = 0;
 
     std::vector<float> paddedImage(paddedHeight * paddedWidth);
-    std::vector<float> sourceImage = this->m_image;
+    std::vector<float> sourceImage = this->getImage();
 
     for (int h = 0; h < paddedHeight; h++) {
         paddedImageRowIndex = h * paddedWidth;
@@ -1,6 +1,108 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
 #include <vector>
 #include <thread>
 #include "kernel.h"
+#include "pngio.h"
+#include "executor.h"
+
+
+#define IMAGE_DEFAULT_BLOCK_SIZE    64
+#define GRADIENT_ORIENTATION_BINS   8
+
+/*
+ * @brief: Storage order of the image matrix
+ */
+enum class ImageLayout
+{
+    ROW_MAJOR,      ///< Rows one after the other
+    TILED           ///< Square blocks stored contiguously, blocks in row-major order
+};
+
+/*
+ * @brief: Convolution algorithm used by the multithread filtering
+ */
+enum class FilterAlgorithm
+{
+    AUTO,           ///< Chosen by the tuning profile
+    DIRECT,         ///< Sum of products for every output pixel
+    VECTORIZED,     ///< Kernel taps accumulated over whole rows, auto-vectorizable
+    SEPARABLE       ///< Row and column 1D passes, for separable kernels only
+};
+
+/*
+ * @brief: Work split among threads
+ */
+enum class FilterPartition
+{
+    AUTO,           ///< Chosen by the tuning profile
+    ROW_BANDS,      ///< One band of consecutive rows per thread
+    TILES           ///< Square tiles picked dynamically by the threads
+};
+
+/*
+ * @brief: Median filter algorithm
+ */
+enum class MedianAlgorithm
+{
+    HISTOGRAM,      ///< Sliding column histograms, constant time per pixel, 8 bit values only
+    SORT            ///< Partial sort of every window
+};
+
+/*
+ * @brief: Grayscale morphology operation with a rectangular structuring element
+ */
+enum class MorphologyOperation
+{
+    EROSION,        ///< Minimum over the element
+    DILATION,       ///< Maximum over the element
+    OPENING,        ///< Erosion followed by dilation
+    CLOSING         ///< Dilation followed by erosion
+};
+
+/*
+ * @brief: 3x3 derivative operator of the gradient
+ */
+enum class GradientOperator
+{
+    SOBEL,          ///< [1 2 1] smoothing, [-1 0 1] derivative
+    SCHARR          ///< [3 10 3] smoothing, [-1 0 1] derivative
+};
+
+/*
+ * @brief: Norm of the gradient magnitude
+ */
+enum class GradientNorm
+{
+    L1,             ///< |Gx| + |Gy|
+    L2              ///< sqrt(Gx^2 + Gy^2)
+};
+
+/*
+ * @brief: Bilateral filter algorithm
+ */
+enum class BilateralAlgorithm
+{
+    GRID,           ///< Splat on a downsampled (x, y, value) grid, blur it, slice it
+    BRUTE_FORCE     ///< Exact weighted sum over a window of radius 2 * spatialSigma
+};
+
+/*
+ * @brief: Options of the filtering. AUTO values (and 0 threads) are
+ *          resolved with the tuning profile, see tuner.h
+ */
+struct FilterOptions
+{
+    FilterOptions() :
+        threadsNumber(1), algorithm(FilterAlgorithm::AUTO), 
+        partition(FilterPartition::AUTO), tileSize(0) {}
+
+    int threadsNumber;              ///< Threads number, 0 for automatic
+    FilterAlgorithm algorithm;      ///< Convolution algorithm
+    FilterPartition partition;      ///< Work split among threads
+    int tileSize;                   ///< Tile side for TILES partition, 0 for automatic
+};
 
 
 class Image
@@ -39,13 +141,49 @@ class Image
          */
         bool setImage(const std::vector<float>& source, int width, int height);
 
+        /*
+         * @brief: set the image taking over a linearized vector, without
+         *          copying it unless the layout is TILED
+         *
+         * @params: source: the row-major matrix to be moved into the state
+         * @return: true is successfull, false otherwise
+         */
+        bool setImage(std::vector<float>&& source, int width, int height);
+
         /*
          * @brief: return the matrix state
          * 
-         * @return: the matrix state
+         * @return: the matrix state, in row-major order
          */
         std::vector<float> getImage() const;
 
+        /*
+         * @brief: return the matrix state without copying it, in the
+         *          storage layout; valid until the image is changed
+         */
+        const float* getData() const;
+
+        /*
+         * @brief: set the storage layout, converting the current matrix.
+         *          Images loaded or set afterwards are converted once, and
+         *          saved images are converted back only for encoding.
+         *
+         * @params: layout: storage layout
+         * @params: blockSize: block side of the TILED layout
+         * @return: true is successfull, false otherwise
+         */
+        bool setLayout(ImageLayout layout, int blockSize = IMAGE_DEFAULT_BLOCK_SIZE);
+
+        /*
+         * @brief: get the storage layout
+         */
+        ImageLayout getLayout() const;
+
+        /*
+         * @brief: get the block side of the TILED layout
+         */
+        int getBlockSize() const;
+
         /*
          * @brief: load an image from filename path
          * 
@@ -62,6 +200,15 @@ class Image
          */
         bool saveImage(const char *filename) const;
 
+        /*
+         * @brief: save an image in filename path with the given encoding settings
+         *
+         * @params: filename: the path where to save the image
+         * @params: settings: compression level, row filter and encoding threads
+         * @return: true is successfull, false otherwise
+         */
+        bool saveImage(const char *filename, const PngSettings& settings) const;
+
         /*o
          * @brief: apply a kernel to the image and pass 
          *         result in resultingImage object
@@ -82,13 +229,160 @@ class Image
          */
         bool applyFilter(const Kernel& kernel);
 
-        bool multithreadFiltering(Image& resultingImage, const Kernel& kernel, int threadsNumber);
+        /*
+         * @brief: apply a kernel to the image splitting rows among threads
+         *          and pass result in resultingImage object
+         * 
+         * @params[out]: resultingImage: the image object where the matrix will be saved
+         * @params[in]: kernel: kernel to be applied to the image
+         * @params[in]: threadsNumber: number of threads
+         * @return: true if successful, false otherwise
+         */
+        bool multithreadFiltering(Image& resultingImage, const Kernel& kernel, int threadsNumber) const;
 
-    private:
         /*
-         * @brief: A common method to apply the kernel to the image
+         * @brief: apply a kernel to the image with the given algorithm and
+         *          work split, and pass result in resultingImage object.
+         *          A TILED image is filtered block by block, threads picking
+         *          the blocks, and the result gets the same layout.
+         * 
+         * @params[out]: resultingImage: the image object where the matrix will be saved
+         * @params[in]: kernel: kernel to be applied to the image
+         * @params[in]: options: threads, algorithm and partition. AUTO values
+         *              are taken from the tuning profile
+         * @return: true if successful, false otherwise
          */
-        std::vector<float> applyFilterCommon(const Kernel& kernel) const;
+        bool multithreadFiltering(Image& resultingImage, const Kernel& kernel, 
+                                    const FilterOptions& options) const;
+
+        /*
+         * @brief: asynchronously load an image on the shared executor
+         *
+         * @params[in]: filename: the path of the image to be loaded
+         * @params[in]: dependency: (optional) job to be completed before loading
+         * @return: the job handle
+         */
+        std::shared_ptr<Job> submitLoad(const char *filename, 
+                                        std::shared_ptr<Job> dependency = nullptr);
+
+        /*
+         * @brief: asynchronously apply a kernel to the image on the shared executor.
+         *          The image and resultingImage must outlive the job, the
+         *          kernel is copied.
+         *
+         * @params[out]: resultingImage: the image object where the matrix will be saved
+         * @params[in]: kernel: kernel to be applied to the image
+         * @params[in]: options: filtering options, resolved as in
+         *              multithreadFiltering. A single thread runs in the job thread
+         * @params[in]: dependency: (optional) job to be completed before filtering,
+         *              e.g. the one loading this image
+         * @return: the job handle
+         */
+        std::shared_ptr<Job> submitFilter(Image& resultingImage, const Kernel& kernel,
+                                            const FilterOptions& options,
+                                            std::shared_ptr<Job> dependency = nullptr) const;
+
+        /*
+         * @brief: asynchronously save the image on the shared executor
+         *
+         * @params[in]: filename: the path where to save the image
+         * @params[in]: settings: encoding settings
+         * @params[in]: dependency: (optional) job to be completed before saving,
+         *              e.g. the one filtering into this image
+         * @return: the job handle
+         */
+        std::shared_ptr<Job> submitSave(const char *filename, const PngSettings& settings,
+                                        std::shared_ptr<Job> dependency = nullptr) const;
+
+        /*
+         * @brief: build a Gaussian pyramid of the image. Every level is the
+         *          previous one filtered with kernel and decimated by 2, but
+         *          only the retained samples are convolved (strided convolution).
+         *          Every thread owns a band of every level and streams its rows
+         *          through all the levels: a row of the next level is computed
+         *          as soon as its source rows are, recomputing the halo rows of
+         *          the neighbouring bands, with no synchronization between levels.
+         * 
+         * @params[out]: levels: pre-allocated images receiving levels 1..levels.size()
+         * @params[in]: kernel: low-pass kernel to be applied before decimation
+         * @params[in]: threadsNumber: number of threads
+         * @return: true if successful, false otherwise
+         */
+        bool buildGaussianPyramid(std::vector<Image*>& levels, const Kernel& kernel, int threadsNumber) const;
+
+        /*
+         * @brief: apply a (2 * radius + 1) square median filter splitting rows
+         *          among threads and pass result in resultingImage object.
+         *          The HISTOGRAM algorithm keeps a histogram per column of the
+         *          band and slides the window histogram along the row (Perreault
+         *          and Hebert), falling back to SORT when values are not 8 bit.
+         *
+         * @params[out]: resultingImage: the image object where the matrix will be saved
+         * @params[in]: radius: window radius
+         * @params[in]: threadsNumber: number of threads
+         * @params[in]: algorithm: histogram or sort based median
+         * @return: true if successful, false otherwise
+         */
+        bool medianFilter(Image& resultingImage, int radius, int threadsNumber,
+                            MedianAlgorithm algorithm = MedianAlgorithm::HISTOGRAM) const;
+
+        /*
+         * @brief: apply a grayscale morphology operation with an elementWidth x
+         *          elementHeight rectangle and pass result in resultingImage object.
+         *          Erosion and dilation are a row pass and a column pass of the
+         *          van Herk/Gil-Werman algorithm (3 comparisons per pixel for any
+         *          element size), each one split among threads; pixels outside
+         *          the image are ignored.
+         *
+         * @params[out]: resultingImage: the image object where the matrix will be saved
+         * @params[in]: operation: erosion, dilation, opening or closing
+         * @params[in]: elementWidth: structuring element width
+         * @params[in]: elementHeight: structuring element height
+         * @params[in]: threadsNumber: number of threads
+         * @return: true if successful, false otherwise
+         */
+        bool morphologyFilter(Image& resultingImage, MorphologyOperation operation,
+                                int elementWidth, int elementHeight, int threadsNumber) const;
+
+        /*
+         * @brief: compute the gradient magnitude, and optionally the quantized
+         *          orientation, splitting rows among threads. Gx and Gy come
+         *          from the same 3x3 neighbourhood in a single pass and are
+         *          normalized by the smoothing weights, so each one is in
+         *          [-255, 255]. Magnitude is not clamped.
+         *
+         * @params[out]: magnitudeImage: the image object where the magnitude will be saved
+         * @params[in]: gradientOperator: Sobel or Scharr
+         * @params[in]: norm: L1 or L2 magnitude
+         * @params[in]: threadsNumber: number of threads
+         * @params[out]: orientationImage: if not NULL, receives the orientation bin
+         *              of every pixel, bins of 360 / orientationBins degrees
+         *              centered on 0, 360 / orientationBins, ... (x right, y down)
+         * @params[in]: orientationBins: number of orientation bins
+         * @return: true if successful, false otherwise
+         */
+        bool gradientFilter(Image& magnitudeImage, GradientOperator gradientOperator,
+                            GradientNorm norm, int threadsNumber, Image* orientationImage = NULL,
+                            int orientationBins = GRADIENT_ORIENTATION_BINS) const;
+
+        /*
+         * @brief: apply an edge-preserving bilateral filter and pass result
+         *          in resultingImage object. The GRID algorithm accumulates
+         *          values and weights on a bilateral grid with cells of
+         *          spatialSigma pixels and rangeSigma levels, blurs it with
+         *          the separable 5x5 gaussian kernel and interpolates it back
+         *          at every pixel (Paris and Durand), so the cost shrinks as
+         *          the sigmas grow. Pixels outside the image are ignored.
+         *
+         * @params[out]: resultingImage: the image object where the matrix will be saved
+         * @params[in]: spatialSigma: standard deviation of the spatial weight, in pixels
+         * @params[in]: rangeSigma: standard deviation of the range weight, in levels
+         * @params[in]: threadsNumber: number of threads
+         * @params[in]: algorithm: bilateral grid or exact brute force
+         * @return: true if successful, false otherwise
+         */
+        bool bilateralFilter(Image& resultingImage, float spatialSigma, float rangeSigma,
+                                int threadsNumber, BilateralAlgorithm algorithm = BilateralAlgorithm::GRID) const;
 
         /*
          * @brief: return a border-replicated padded matrix using matrix state 
@@ -97,6 +391,27 @@ class Image
         std::vector<float> buildReplicatePaddedImage(const int paddingHeight,
                                                     const int paddingWidth) const;
 
+        /*
+         * @brief: buildReplicatePaddedImage writing into a caller buffer of
+         *          (height + 2 * paddingHeight) x (width + 2 * paddingWidth) values
+         */
+        void buildReplicatePaddedImage(const int paddingHeight, const int paddingWidth,
+                                        float* paddedImage) const;
+
+        /*
+         * @brief: return a padded matrix whose border pixels repeat the
+         *          nearest image pixel, for the operators that need exact
+         *          edge semantics (median, gradient)
+         */
+        std::vector<float> buildClampedPaddedImage(const int paddingHeight,
+                                                    const int paddingWidth) const;
+
+    private:
+        /*
+         * @brief: A common method to apply the kernel to the image
+         */
+        std::vector<float> applyFilterCommon(const Kernel& kernel) const;
+
         /*
          * @brief: return a zero padded matrix using matrix state 
          *          and requested padding
@@ -107,5 +422,8 @@ class Image
         std::vector<float> m_image;               ///< Linearized matrix containing the image pixels' values
         int m_imageWidth;                       ///< Matrix width
         int m_imageHeight;                      ///< Matrix height
-        std::vector<std::thread> m_threads;     ///< Vector used to store thread for multithread filtering
-};
\ No newline at end of file
+        ImageLayout m_layout;                   ///< Storage order of m_image
+        int m_blockSize;                        ///< Block side of the TILED layout
+};
+
+#endif
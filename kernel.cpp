@@ -9,9 +9,11 @@
 #define LAPLACIAN_FILTER_MIN    -1
 #define LINE_DETECTOR_MAX       8
 #define LINE_DETECTOR_MIN       -1
+#define SEPARABLE_TOLERANCE     1e-6
 
 
-Kernel::Kernel() 
+Kernel::Kernel() :
+    m_filterWidth(0), m_filterHeight(0)
 {}
 
 void Kernel::printKernel() const
@@ -157,6 +159,41 @@ bool Kernel::setGaussianLaplacianFilter()
     return true;
 }
 
+bool Kernel::setFilter(const std::string& filterName)
+{
+    if (filterName == GAUSSIAN_FILTER_NAME) {
+        return this->setGaussianFilter(7, 7, 1);
+    }
+    else if (filterName == SHARPEN_FILTER_NAME) {
+        return this->setSharpenFilter();
+    }
+    else if (filterName == EDGE_DETECTION_FILTER_NAME) {
+        return this->setEdgeDetectionFilter();
+    }
+    else if (filterName == LAPLACIAN_FILTER_NAME) {
+        return this->setLaplacianFilter();
+    }
+    else if (filterName == GAUSSIAN_LAPLACIAN_FILTER_NAME) {
+        return this->setGaussianLaplacianFilter();
+    }
+
+    std::cerr << "Unknown filter " << filterName << std::endl;
+
+    return false;
+}
+
+std::vector<std::string> Kernel::getFilterNames()
+{
+    std::vector<std::string> names;
+    names.push_back(GAUSSIAN_FILTER_NAME);
+    names.push_back(SHARPEN_FILTER_NAME);
+    names.push_back(EDGE_DETECTION_FILTER_NAME);
+    names.push_back(LAPLACIAN_FILTER_NAME);
+    names.push_back(GAUSSIAN_LAPLACIAN_FILTER_NAME);
+
+    return names;
+}
+
 bool Kernel::buildKernelCommon(std::vector<float> &kernel, int max, int min, int height, int width)
 {
     for (int i = 0; i < height; i++) {
@@ -187,4 +224,65 @@ int Kernel::getKernelHeight() const
 std::vector<float> Kernel::getKernel() const
 {
     return this->m_filterMatrix;
+}
+
+bool Kernel::getSeparableFilters(std::vector<float>& columnFilter, std::vector<float>& rowFilter) const
+{
+    int height = m_filterHeight;
+    int width = m_filterWidth;
+
+    if (height == 0 || width == 0) {
+        return false;
+    }
+
+    // Pivot on the largest coefficient: a rank 1 kernel is the product
+    // of its pivot column and its pivot row divided by the pivot
+    int pivotRow = 0;
+    int pivotColumn = 0;
+    float maxValue = 0;
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            if (std::fabs(m_filterMatrix[j + i * width]) > maxValue) {
+                maxValue = std::fabs(m_filterMatrix[j + i * width]);
+                pivotRow = i;
+                pivotColumn = j;
+            }
+        }
+    }
+
+    if (maxValue == 0) {
+        return false;
+    }
+
+    float pivot = m_filterMatrix[pivotColumn + pivotRow * width];
+    std::vector<float> column(height);
+    std::vector<float> row(width);
+    for (int i = 0; i < height; i++) {
+        column[i] = m_filterMatrix[pivotColumn + i * width];
+    }
+    for (int j = 0; j < width; j++) {
+        row[j] = m_filterMatrix[j + pivotRow * width] / pivot;
+    }
+
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            if (std::fabs(column[i] * row[j] - m_filterMatrix[j + i * width]) > 
+                    SEPARABLE_TOLERANCE * maxValue) {
+                return false;
+            }
+        }
+    }
+
+    columnFilter = column;
+    rowFilter = row;
+
+    return true;
+}
+
+bool Kernel::isSeparable() const
+{
+    std::vector<float> columnFilter;
+    std::vector<float> rowFilter;
+
+    return getSeparableFilters(columnFilter, rowFilter);
 }
\ No newline at end of file
@@ -1,4 +1,15 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
 #include <vector>
+#include <string>
+
+
+#define GAUSSIAN_FILTER_NAME            "gaussian"
+#define SHARPEN_FILTER_NAME             "sharpen"
+#define EDGE_DETECTION_FILTER_NAME      "edge_detect"
+#define LAPLACIAN_FILTER_NAME           "laplacian"
+#define GAUSSIAN_LAPLACIAN_FILTER_NAME  "gaussian_laplacian"
 
 
 class Kernel 
@@ -57,6 +68,21 @@ class Kernel
          */
         bool setGaussianLaplacianFilter();
 
+        /*
+         * @brief: Set up the Kernel object from a filter name: gaussian (7x7,
+         *          standard deviation 1), sharpen, edge_detect, laplacian
+         *          or gaussian_laplacian
+         * 
+         * @param: filterName: name of the filter
+         * @return: true for successful setup, false otherwise
+         */
+        bool setFilter(const std::string& filterName);
+
+        /*
+         * @brief: return the filter names accepted by setFilter
+         */
+        static std::vector<std::string> getFilterNames();
+
         /*
          * @brief: return the kernel width
          */
@@ -72,6 +98,21 @@ class Kernel
          */
         std::vector<float> getKernel() const;
 
+        /*
+         * @brief: decompose the kernel as the outer product of a column
+         *          and a row filter, if possible
+         *
+         * @params[out]: columnFilter: vertical 1D filter (height values)
+         * @params[out]: rowFilter: horizontal 1D filter (width values)
+         * @return: true if the kernel is separable, false otherwise
+         */
+        bool getSeparableFilters(std::vector<float>& columnFilter, std::vector<float>& rowFilter) const;
+
+        /*
+         * @brief: return true if the kernel is separable
+         */
+        bool isSeparable() const;
+
     private:
         /*
          * @brief: A common method used to build a kernel
@@ -81,4 +122,6 @@ class Kernel
         std::vector<float> m_filterMatrix;     ///< Linearized matrix containing the kernel 
         int m_filterWidth;                      ///< Kernel height
         int m_filterHeight;                     ///< Kernel width
-};
\ No newline at end of file
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <math.h>
+#include "lazy.h"
+#include "tuner.h"
+#include "convolution.h"
+
+
+/*
+ * @brief: Rectangle [startLine, stopLine) x [startColumn, stopColumn) of the image
+ */
+struct LazyBox
+{
+    int startLine;
+    int stopLine;
+    int startColumn;
+    int stopColumn;
+};
+
+/*
+ * @brief: A stage ready to be run on tiles
+ */
+struct LazyPlan
+{
+    LazyOperation operation;
+    int padding;                        ///< Kernel radius, 0 for pointwise stages
+    int filterWidth;                    ///< Kernel side
+    RegionConv conv;                    ///< Region convolution of the chosen algorithm
+    std::vector<float> mask;            ///< Linearized kernel
+    std::vector<float> columnFilter;    ///< Vertical 1D filter, separable kernels only
+    std::vector<float> rowFilter;       ///< Horizontal 1D filter, separable kernels only
+    float minValue;
+    float maxValue;
+};
+
+/*
+ * @brief: Data shared by the evaluation threads
+ */
+struct LazyData
+{
+    const float* source;                        ///< Row-major source matrix
+    float* outImage;                            ///< Row-major output matrix
+    int width;                                  ///< Image width
+    int height;                                 ///< Image height
+    int tileSize;                               ///< Output tile side
+    int tilesPerRow;                            ///< Tiles in a row of tiles
+    int tilesNumber;                            ///< Tiles in the image
+    const std::vector<LazyPlan>* plans;         ///< Stages in order
+    std::vector<std::vector<long long>>* durations;     ///< Per thread, per stage ns
+};
+
+void threadLazyTiles(const LazyData* data, int threadIndex, std::atomic<int>* nextTile);
+
+/*
+ * @brief: range of source lines (or columns) read by the padded elements
+ *          [start, stop + 2 * padding) along an axis, see getReplicateSource.
+ *          otherBorder tells if the padded elements along the other axis
+ *          reach the border, where the replication does not shift.
+ */
+static void getRequiredRange(int start, int stop, int padding, int size, bool otherBorder,
+                                int& first, int& last)
+{
+    int paddedStop = stop + 2 * padding;
+    first = size;
+    last = -1;
+
+    if (start < padding) {
+        first = 0;
+        last = std::max(last, 0);
+    }
+    if (paddedStop - 1 > size - 1) {
+        first = std::min(first, size - 1);
+        last = size - 1;
+    }
+
+    int inside = std::max(start, padding);
+    int insideStop = std::min(paddedStop - 1, size - 1);
+    if (inside <= insideStop) {
+        first = std::min(first, inside - padding);
+        last = std::max(last, insideStop - padding);
+        if (otherBorder) {
+            first = std::min(first, inside);
+            last = std::max(last, insideStop);
+        }
+    }
+}
+
+/*
+ * @brief: box of the stage input needed to compute box of its output
+ */
+static LazyBox getRequiredBox(const LazyBox& box, int padding, int height, int width)
+{
+    bool columnsBorder = box.startColumn < padding || box.stopColumn + 2 * padding - 1 > width - 1;
+    bool linesBorder = box.startLine < padding || box.stopLine + 2 * padding - 1 > height - 1;
+
+    LazyBox required;
+    getRequiredRange(box.startLine, box.stopLine, padding, height, columnsBorder,
+                        required.startLine, required.stopLine);
+    getRequiredRange(box.startColumn, box.stopColumn, padding, width, linesBorder,
+                        required.startColumn, required.stopColumn);
+    required.stopLine++;
+    required.stopColumn++;
+
+    return required;
+}
+
+/*
+ * @brief: build the replicate padded matrix of box from the input values
+ *          of inBox, stored with inStride
+ */
+static void gatherPadded(const float* in, const LazyBox& inBox, int inStride, const LazyBox& box,
+                            int padding, int height, int width, float* padded)
+{
+    int paddedWidth = box.stopColumn - box.startColumn + 2 * padding;
+    int paddedHeight = box.stopLine - box.startLine + 2 * padding;
+    bool insideColumns = box.startColumn >= padding && box.startColumn + paddedWidth - 1 <= width - 1;
+
+    for (int i = 0; i < paddedHeight; i++) {
+        int h = box.startLine + i;
+        float* paddedRow = padded + i * paddedWidth;
+
+        if (insideColumns && h >= padding && h <= height - 1) {
+            const float* source = in + (h - padding - inBox.startLine) * inStride +
+                                    box.startColumn - padding - inBox.startColumn;
+            std::copy(source, source + paddedWidth, paddedRow);
+            continue;
+        }
+
+        for (int j = 0; j < paddedWidth; j++) {
+            int y = 0;
+            int x = 0;
+            getReplicateSource(h, box.startColumn + j, padding, padding, height, width, y, x);
+            paddedRow[j] = in[(y - inBox.startLine) * inStride + x - inBox.startColumn];
+        }
+    }
+}
+
+void threadLazyTiles(const LazyData* data, int threadIndex, std::atomic<int>* nextTile)
+{
+    const std::vector<LazyPlan>& plans = *data->plans;
+    int stagesNumber = plans.size();
+    std::vector<long long>& durations = (*data->durations)[threadIndex];
+
+    // boxes[k] and buffers[k] hold the output of stage k, 0 is the source
+    std::vector<LazyBox> boxes(stagesNumber + 1);
+    std::vector<std::vector<float>> buffers(stagesNumber + 1);
+    std::vector<float> padded;
+
+    for (int t = nextTile->fetch_add(1); t < data->tilesNumber; t = nextTile->fetch_add(1)) {
+        LazyBox& tile = boxes[stagesNumber];
+        tile.startLine = (t / data->tilesPerRow) * data->tileSize;
+        tile.startColumn = (t % data->tilesPerRow) * data->tileSize;
+        tile.stopLine = std::min(tile.startLine + data->tileSize, data->height);
+        tile.stopColumn = std::min(tile.startColumn + data->tileSize, data->width);
+
+        // Halos accumulate from the last stage back to the source
+        for (int k = stagesNumber - 1; k >= 0; k--) {
+            boxes[k] = getRequiredBox(boxes[k + 1], plans[k].padding, data->height, data->width);
+        }
+
+        for (int k = 0; k < stagesNumber; k++) {
+            auto t1 = std::chrono::high_resolution_clock::now();
+
+            const LazyPlan& plan = plans[k];
+            const LazyBox& box = boxes[k + 1];
+            int boxWidth = box.stopColumn - box.startColumn;
+            int boxHeight = box.stopLine - box.startLine;
+
+            LazyBox inBox = { 0, data->height, 0, data->width };
+            const float* in = data->source;
+            int inStride = data->width;
+            if (k > 0) {
+                inBox = boxes[k];
+                in = buffers[k].data();
+                inStride = inBox.stopColumn - inBox.startColumn;
+            }
+
+            std::vector<float>& out = buffers[k + 1];
+            out.resize(boxWidth * boxHeight);
+
+            if (plan.operation == LazyOperation::FILTER) {
+                padded.resize((boxWidth + 2 * plan.padding) * (boxHeight + 2 * plan.padding));
+                gatherPadded(in, inBox, inStride, box, plan.padding, data->height, data->width,
+                                padded.data());
+
+                ConvData convData;
+                convData.paddedImage = padded.data();
+                convData.outImage = out.data();
+                convData.width = boxWidth;
+                convData.height = boxHeight;
+                convData.filterWidth = plan.filterWidth;
+                convData.mask = plan.mask.data();
+                convData.columnFilter = plan.columnFilter.data();
+                convData.rowFilter = plan.rowFilter.data();
+                plan.conv(convData, 0, boxHeight, 0, boxWidth);
+            }
+            else {
+                for (int l = 0; l < boxHeight; l++) {
+                    const float* inRow = in + (box.startLine + l - inBox.startLine) * inStride +
+                                            box.startColumn - inBox.startColumn;
+                    float* outRow = out.data() + l * boxWidth;
+                    for (int x = 0; x < boxWidth; x++) {
+                        outRow[x] = std::min(std::max(inRow[x], plan.minValue), plan.maxValue);
+                    }
+                }
+            }
+
+            auto t2 = std::chrono::high_resolution_clock::now();
+            durations[k] += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+        }
+
+        int tileWidth = tile.stopColumn - tile.startColumn;
+        for (int l = tile.startLine; l < tile.stopLine; l++) {
+            const float* tileRow = buffers[stagesNumber].data() + (l - tile.startLine) * tileWidth;
+            std::copy(tileRow, tileRow + tileWidth, data->outImage + l * data->width + tile.startColumn);
+        }
+    }
+}
+
+LazyImage::LazyImage(const Image& source) :
+    m_source(source)
+{}
+
+LazyImage& LazyImage::filter(const Kernel& kernel, const std::string& name)
+{
+    LazyStage stage;
+    stage.operation = LazyOperation::FILTER;
+    stage.name = name;
+    stage.kernel = kernel;
+    stage.minValue = 0;
+    stage.maxValue = 0;
+    m_stages.push_back(stage);
+
+    return *this;
+}
+
+LazyImage& LazyImage::clamp(float minValue, float maxValue)
+{
+    LazyStage stage;
+    stage.operation = LazyOperation::CLAMP;
+    stage.name = "clamp";
+    stage.minValue = minValue;
+    stage.maxValue = maxValue;
+    m_stages.push_back(stage);
+
+    return *this;
+}
+
+const std::vector<LazyStage>& LazyImage::getStages() const
+{
+    return m_stages;
+}
+
+bool LazyImage::evaluate(Image& resultingImage, const FilterOptions& options) const
+{
+    std::cout << "Evaluating " << m_stages.size() << " deferred stages" << std::endl;
+
+    // Get image dimensions
+    int height = m_source.getImageHeight();
+    int width = m_source.getImageWidth();
+
+    // Stages plans, algorithms resolved like multithreadFiltering
+    std::vector<LazyPlan> plans(m_stages.size());
+    for (unsigned int k = 0; k < m_stages.size(); k++) {
+        const LazyStage& stage = m_stages[k];
+        LazyPlan& plan = plans[k];
+        plan.operation = stage.operation;
+        plan.padding = 0;
+        plan.filterWidth = 0;
+        plan.conv = convDirect;
+        plan.minValue = stage.minValue;
+        plan.maxValue = stage.maxValue;
+
+        if (stage.operation != LazyOperation::FILTER) {
+            std::cout << "Stage " << k + 1 << " " << stage.name << std::endl;
+            continue;
+        }
+
+        int filterWidth = stage.kernel.getKernelWidth();
+        if (filterWidth == 0 || filterWidth != stage.kernel.getKernelHeight()) {
+            std::cerr << "Invalid filter dimension" << std::endl;
+            return false;
+        }
+        plan.filterWidth = filterWidth;
+        plan.padding = floor(filterWidth / 2);
+        plan.mask = stage.kernel.getKernel();
+
+        FilterOptions resolved = Tuner::resolveOptions(options, stage.kernel, width, height);
+        if (resolved.algorithm == FilterAlgorithm::SEPARABLE &&
+                !stage.kernel.getSeparableFilters(plan.columnFilter, plan.rowFilter)) {
+            std::cerr << "Kernel is not separable, using direct convolution" << std::endl;
+            resolved.algorithm = FilterAlgorithm::DIRECT;
+        }
+        if (resolved.algorithm == FilterAlgorithm::VECTORIZED) {
+            plan.conv = convVectorized;
+        }
+        else if (resolved.algorithm == FilterAlgorithm::SEPARABLE) {
+            plan.conv = convSeparable;
+        }
+
+        std::cout << "Stage " << k + 1 << " " << stage.name << ": "
+                  << Tuner::getAlgorithmName(resolved.algorithm) << std::endl;
+    }
+
+    int threadsNumber = options.threadsNumber > 0 ? options.threadsNumber :
+                            std::max(1u, std::thread::hardware_concurrency());
+    int tileSize = options.tileSize > 0 ? options.tileSize : LAZY_DEFAULT_TILE_SIZE;
+
+    // Blocks are read as rows only when the source is tiled
+    std::vector<float> rowMajorImage;
+    if (m_source.getLayout() == ImageLayout::TILED) {
+        rowMajorImage = m_source.getImage();
+    }
+
+    std::vector<float> newImage(height * width);
+    std::vector<std::vector<long long>> durations(threadsNumber,
+                                                    std::vector<long long>(plans.size(), 0));
+
+    LazyData data;
+    data.source = m_source.getLayout() == ImageLayout::TILED ? rowMajorImage.data() :
+                                                                m_source.getData();
+    data.outImage = newImage.data();
+    data.width = width;
+    data.height = height;
+    data.tileSize = tileSize;
+    data.tilesPerRow = (width + tileSize - 1) / tileSize;
+    data.tilesNumber = data.tilesPerRow * ((height + tileSize - 1) / tileSize);
+    data.plans = &plans;
+    data.durations = &durations;
+
+    std::cout << "Tiles: " << tileSize << ", threads: " << threadsNumber << std::endl;
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    if (plans.empty()) {
+        std::copy(data.source, data.source + height * width, newImage.begin());
+    }
+    else {
+        std::atomic<int> nextTile(0);
+        std::vector<std::thread> threads;
+        for (int i = 1; i < threadsNumber; i++) {
+            threads.push_back(std::thread(threadLazyTiles, &data, i, &nextTile));
+        }
+        threadLazyTiles(&data, 0, &nextTile);
+        for (unsigned int i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    // Stage times are summed over the threads
+    for (unsigned int k = 0; k < plans.size(); k++) {
+        long long stageDuration = 0;
+        for (int i = 0; i < threadsNumber; i++) {
+            stageDuration += durations[i][k];
+        }
+        std::cout << "Stage " << k + 1 << " " << m_stages[k].name << " execution time: "
+                  << stageDuration / 1000 << " μs" << std::endl;
+    }
+    auto evaluationDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    std::cout << "Lazy evaluation execution time: " << evaluationDuration << " μs" << std::endl;
+
+    resultingImage.setImage(std::move(newImage), width, height);
+
+    std::cout << "Done!" << std::endl;
+
+    return true;
+}
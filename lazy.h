@@ -0,0 +1,81 @@
+#ifndef LAZY_H
+#define LAZY_H
+
+#include <string>
+#include <vector>
+#include "image.h"
+
+
+#define LAZY_DEFAULT_TILE_SIZE  64
+
+/*
+ * @brief: Operation of a deferred stage
+ */
+enum class LazyOperation
+{
+    FILTER,         ///< Kernel convolution, a stencil with halo
+    CLAMP           ///< Pointwise clamp
+};
+
+/*
+ * @brief: A deferred stage
+ */
+struct LazyStage
+{
+    LazyOperation operation;
+    std::string name;               ///< Name in the timings report
+    Kernel kernel;                  ///< FILTER only
+    float minValue;                 ///< CLAMP only
+    float maxValue;                 ///< CLAMP only
+};
+
+/*
+ * @brief: Deferred operations on an image. Operations only record a
+ *          stage; evaluate() runs the whole chain tile by tile: for every
+ *          output tile the input box needed by every stage is derived
+ *          backwards (halos accumulate), then the stages run forwards on
+ *          tile sized buffers. No whole-image temporary is written, and
+ *          the result equals running the operations one after the other.
+ */
+class LazyImage
+{
+    public:
+        /*
+         * @param: source: image the operations start from, must be alive
+         *          until evaluation
+         */
+        LazyImage(const Image& source);
+
+        /*
+         * @brief: defer the application of a kernel, see Image::multithreadFiltering
+         */
+        LazyImage& filter(const Kernel& kernel, const std::string& name = "filter");
+
+        /*
+         * @brief: defer the clamp of every value in [minValue, maxValue]
+         */
+        LazyImage& clamp(float minValue, float maxValue);
+
+        /*
+         * @brief: run the deferred stages and pass result in resultingImage
+         *          object, reporting the time spent in every stage
+         *
+         * @params[out]: resultingImage: the image object where the matrix will be saved
+         * @params[in]: options: threads, convolution algorithm (AUTO values
+         *              from the tuning profile) and tile side (0 for default);
+         *              the partition is always TILES
+         * @return: true if successful, false otherwise
+         */
+        bool evaluate(Image& resultingImage, const FilterOptions& options) const;
+
+        /*
+         * @brief: get the deferred stages
+         */
+        const std::vector<LazyStage>& getStages() const;
+
+    private:
+        const Image& m_source;
+        std::vector<LazyStage> m_stages;
+};
+
+#endif
@@ -1,18 +1,44 @@
 #include <iostream>
 #include <chrono>
+#include <algorithm>
+#include <math.h>
 #include "image.h"
+#include "tuner.h"
+#include "check.h"
+#include "server.h"
+#include "shard.h"
+#include "lazy.h"
 
 
-#define GAUSSIAN_FILTER_COMMAND             "gaussian"
-#define SHARPENING_FILTER_COMMAND           "sharpen"
-#define EDGE_DETECTION_FILTER_COMMAND       "edge_detect"
-#define LAPLACIAN_FILTER_COMMAND            "laplacian"
-#define GAUSSIAN_LAPLACIAN_COMMAND          "gaussian_laplacian"
+#define GAUSSIAN_FILTER_COMMAND             GAUSSIAN_FILTER_NAME
+#define SHARPENING_FILTER_COMMAND           SHARPEN_FILTER_NAME
+#define EDGE_DETECTION_FILTER_COMMAND       EDGE_DETECTION_FILTER_NAME
+#define LAPLACIAN_FILTER_COMMAND            LAPLACIAN_FILTER_NAME
+#define GAUSSIAN_LAPLACIAN_COMMAND          GAUSSIAN_LAPLACIAN_FILTER_NAME
+#define GAUSSIAN_PYRAMID_COMMAND            "pyramid"
+#define TUNE_COMMAND                        "tune"
+#define CHECK_COMMAND                       "check"
+#define CHECK_BASELINE_COMMAND              "check_baseline"
+#define SERVE_COMMAND                       "serve"
+#define SUBMIT_COMMAND                      "submit"
+#define SHARD_COMMAND                       "shard"
+#define MEDIAN_COMMAND                      "median"
+#define MEDIAN_BENCHMARK_COMMAND            "median_bench"
+#define MORPHOLOGY_COMMAND                  "morphology"
+#define GRADIENT_COMMAND                    "gradient"
+#define BILATERAL_COMMAND                   "bilateral"
+#define CHAIN_COMMAND                       "chain"
+#define CHAIN_CLAMP_STAGE                   "clamp"
 
 #define OUTPUT_FOLDER   "output/"
 #define IMAGE_EXT       ".png"
 #define IMAGES_NUMBER   1
-#define THREAD_NUMBER   4
+#define THREAD_NUMBER   0           ///< 0 lets the tuning profile choose
+#define PYRAMID_LEVELS  4
+#define MEDIAN_RADIUS   2
+#define MEDIAN_MAX_BENCHMARK_RADIUS     16
+#define BILATERAL_SPATIAL_SIGMA         4
+#define BILATERAL_RANGE_SIGMA           20
 
 enum class FilterType
 {
@@ -20,19 +46,414 @@ enum class FilterType
     SHARPEN_FILTER,
     EDGE_DETECTION,
     LAPLACIAN_FILTER,
-    GAUSSIAN_LAPLACIAN_FILTER
+    GAUSSIAN_LAPLACIAN_FILTER,
+    GAUSSIAN_PYRAMID
 };
 
 int main(int argc, char *argv[]) 
 {
+    // Client of the daemon mode: send a job and print the reply only
+    if (argc > 3 && std::string(argv[1]) == SUBMIT_COMMAND) {
+        std::string request;
+        for (int i = 3; i < argc; i++) {
+            request += (i > 3 ? " " : "") + std::string(argv[i]);
+        }
+        std::string reply;
+        if (!Server::sendRequest(argv[2], request, reply)) {
+            return 1;
+        }
+        std::cout << reply << std::endl;
+        return reply.compare(0, 2, "OK") == 0 ? 0 : 1;
+    }
+
     std::cout << "===== Multithread kernel convolution =====" << std::endl;
 
+    // Tuning mode: measure the filtering configurations and write the profile
+    if (argc > 1 && std::string(argv[1]) == TUNE_COMMAND) {
+        int maxThreads = argc > 2 ? atoi(argv[2]) : 0;
+        return Tuner::tune(Tuner::getProfilePath().c_str(), maxThreads) ? 0 : 1;
+    }
+
+    // Check mode: compare every execution path with golden outputs and baseline
+    if (argc > 1 && (std::string(argv[1]) == CHECK_COMMAND || 
+                     std::string(argv[1]) == CHECK_BASELINE_COMMAND)) {
+        CheckSettings checkSettings;
+        checkSettings.recordBaseline = std::string(argv[1]) == CHECK_BASELINE_COMMAND;
+        if (argc > 2) {
+            checkSettings.tolerance = atoi(argv[2]);
+        }
+        if (argc > 3) {
+            checkSettings.maxSlowdown = atof(argv[3]);
+        }
+        return runCheck(checkSettings) ? 0 : 1;
+    }
+
+    // Daemon mode: serve jobs on a Unix domain socket with warm state
+    if (argc > 2 && std::string(argv[1]) == SERVE_COMMAND) {
+        int serverThreads = argc > 3 ? atoi(argv[3]) : 0;
+        if (serverThreads <= 0) {
+            serverThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        Server server(argv[2], serverThreads);
+        return server.run() ? 0 : 1;
+    }
+
+    // Sharded mode: filter with worker processes and compare with the threads
+    if (argc > 3 && std::string(argv[1]) == SHARD_COMMAND) {
+        Kernel kernel;
+        Image source;
+        if (!kernel.setFilter(argv[2]) || !source.loadImage(argv[3])) {
+            std::cerr << "Invalid filter type or image" << std::endl;
+            return 1;
+        }
+
+        int processesNumber = argc > 4 ? atoi(argv[4]) : 0;
+        if (processesNumber <= 0) {
+            processesNumber = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        SharedMemoryTransport sharedMemoryTransport;
+        StreamTransport streamTransport;
+        ShardTransport* transport = &sharedMemoryTransport;
+        if (argc > 5 && std::string(argv[5]) == SHARD_TRANSPORT_STREAM) {
+            transport = &streamTransport;
+        }
+
+        Image sharded;
+        ShardCoordinator coordinator(*transport, processesNumber);
+        if (!coordinator.filter(source, sharded, kernel)) {
+            return 1;
+        }
+
+        Image reference;
+        source.multithreadFiltering(reference, kernel, processesNumber);
+
+        std::vector<float> shardedPixels = sharded.getImage();
+        std::vector<float> referencePixels = reference.getImage();
+        float maxDifference = 0;
+        for (unsigned int i = 0; i < shardedPixels.size(); i++) {
+            maxDifference = std::max(maxDifference, std::abs(shardedPixels[i] - referencePixels[i]));
+        }
+        std::cout << "Max difference from multithread filtering: " << maxDifference << std::endl;
+
+        sharded.saveImage(std::string(std::string(OUTPUT_FOLDER) + "1_" + argv[2] +
+                                        "_sharded" + std::string(IMAGE_EXT)).c_str());
+
+        return 0;
+    }
+
+    // Median mode: histogram median, compared with the sort based one
+    if (argc > 2 && (std::string(argv[1]) == MEDIAN_COMMAND ||
+                     std::string(argv[1]) == MEDIAN_BENCHMARK_COMMAND)) {
+        Image source;
+        if (!source.loadImage(argv[2])) {
+            return 1;
+        }
+
+        bool benchmark = std::string(argv[1]) == MEDIAN_BENCHMARK_COMMAND;
+        int radius = benchmark ? MEDIAN_MAX_BENCHMARK_RADIUS : MEDIAN_RADIUS;
+        if (argc > 3 && atoi(argv[3]) > 0) {
+            radius = atoi(argv[3]);
+        }
+        int medianThreads = argc > 4 ? atoi(argv[4]) : 0;
+        if (medianThreads <= 0) {
+            medianThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // The benchmark doubles the radius up to the requested one
+        int firstRadius = benchmark ? 1 : radius;
+        for (int r = firstRadius; r <= radius; r *= 2) {
+            Image histogramResult;
+            Image sortResult;
+            std::streambuf* coutBuffer = benchmark ? std::cout.rdbuf(NULL) : std::cout.rdbuf();
+
+            auto t1 = std::chrono::high_resolution_clock::now();
+            source.medianFilter(histogramResult, r, medianThreads, MedianAlgorithm::HISTOGRAM);
+            auto t2 = std::chrono::high_resolution_clock::now();
+            source.medianFilter(sortResult, r, medianThreads, MedianAlgorithm::SORT);
+            auto t3 = std::chrono::high_resolution_clock::now();
+
+            std::cout.rdbuf(coutBuffer);
+
+            std::vector<float> histogramPixels = histogramResult.getImage();
+            std::vector<float> sortPixels = sortResult.getImage();
+            float maxDifference = 0;
+            for (unsigned int i = 0; i < histogramPixels.size(); i++) {
+                maxDifference = std::max(maxDifference, std::abs(histogramPixels[i] - sortPixels[i]));
+            }
+
+            auto histogramDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+            auto sortDuration = std::chrono::duration_cast<std::chrono::microseconds>(t3 - t2).count();
+            std::cout << "Radius " << r << ": histogram " << histogramDuration << " μs, sort "
+                      << sortDuration << " μs, speedup "
+                      << static_cast<double>(sortDuration) / std::max(static_cast<double>(histogramDuration), 1.0)
+                      << ", max difference " << maxDifference << std::endl;
+
+            if (!benchmark) {
+                histogramResult.saveImage(std::string(std::string(OUTPUT_FOLDER) + "1_" +
+                                            MEDIAN_COMMAND + std::string(IMAGE_EXT)).c_str());
+                break;
+            }
+        }
+
+        return 0;
+    }
+
+    // Morphology mode, optionally on the output of a filter kept in memory
+    if (argc > 5 && std::string(argv[1]) == MORPHOLOGY_COMMAND) {
+        std::string operationName = argv[2];
+        MorphologyOperation operation;
+        if (operationName == "erode") {
+            operation = MorphologyOperation::EROSION;
+        }
+        else if (operationName == "dilate") {
+            operation = MorphologyOperation::DILATION;
+        }
+        else if (operationName == "open") {
+            operation = MorphologyOperation::OPENING;
+        }
+        else if (operationName == "close") {
+            operation = MorphologyOperation::CLOSING;
+        }
+        else {
+            std::cerr << "Invalid morphology operation " << operationName << std::endl;
+            return 1;
+        }
+
+        Image source;
+        if (!source.loadImage(argv[3])) {
+            return 1;
+        }
+
+        int morphologyThreads = argc > 6 ? atoi(argv[6]) : 0;
+        if (morphologyThreads <= 0) {
+            morphologyThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        std::string outputName = operationName;
+        if (argc > 7) {
+            Kernel kernel;
+            if (!kernel.setFilter(argv[7])) {
+                std::cerr << "Invalid filter type " << argv[7] << std::endl;
+                return 1;
+            }
+            Image filtered;
+            source.multithreadFiltering(filtered, kernel, morphologyThreads);
+            source = filtered;
+            outputName = std::string(argv[7]) + "_" + operationName;
+        }
+
+        Image result;
+        if (!source.morphologyFilter(result, operation, atoi(argv[4]), atoi(argv[5]), morphologyThreads)) {
+            return 1;
+        }
+        result.saveImage(std::string(std::string(OUTPUT_FOLDER) + "1_" + outputName +
+                                        std::string(IMAGE_EXT)).c_str());
+
+        return 0;
+    }
+
+    // Gradient mode: fused magnitude and orientation
+    if (argc > 4 && std::string(argv[1]) == GRADIENT_COMMAND) {
+        std::string operatorName = argv[2];
+        std::string normName = argv[3];
+        if ((operatorName != "sobel" && operatorName != "scharr") ||
+                (normName != "l1" && normName != "l2")) {
+            std::cerr << "Invalid gradient operator or norm" << std::endl;
+            return 1;
+        }
+
+        Image source;
+        if (!source.loadImage(argv[4])) {
+            return 1;
+        }
+
+        int gradientThreads = argc > 5 ? atoi(argv[5]) : 0;
+        if (gradientThreads <= 0) {
+            gradientThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        int orientationBins = argc > 6 ? atoi(argv[6]) : 0;
+
+        Image magnitude;
+        Image orientation;
+        if (!source.gradientFilter(magnitude, operatorName == "sobel" ? GradientOperator::SOBEL : GradientOperator::SCHARR,
+                                    normName == "l1" ? GradientNorm::L1 : GradientNorm::L2, gradientThreads,
+                                    orientationBins > 0 ? &orientation : NULL, orientationBins)) {
+            return 1;
+        }
+        magnitude.saveImage(std::string(std::string(OUTPUT_FOLDER) + "1_" + operatorName +
+                                        std::string(IMAGE_EXT)).c_str());
+
+        // Bins are spread over the gray levels to be visible
+        if (orientationBins > 0) {
+            std::vector<float> bins = orientation.getImage();
+            for (unsigned int i = 0; i < bins.size(); i++) {
+                bins[i] = orientationBins > 1 ? bins[i] * 255 / (orientationBins - 1) : 0;
+            }
+            orientation.setImage(bins, orientation.getImageWidth(), orientation.getImageHeight());
+            orientation.saveImage(std::string(std::string(OUTPUT_FOLDER) + "1_" + operatorName +
+                                                "_orientation" + std::string(IMAGE_EXT)).c_str());
+        }
+
+        return 0;
+    }
+
+    // Bilateral mode: bilateral grid, compared with the exact brute force
+    if (argc > 2 && std::string(argv[1]) == BILATERAL_COMMAND) {
+        Image source;
+        if (!source.loadImage(argv[2])) {
+            return 1;
+        }
+
+        float spatialSigma = argc > 3 ? atof(argv[3]) : BILATERAL_SPATIAL_SIGMA;
+        float rangeSigma = argc > 4 ? atof(argv[4]) : BILATERAL_RANGE_SIGMA;
+        int bilateralThreads = argc > 5 ? atoi(argv[5]) : 0;
+        if (bilateralThreads <= 0) {
+            bilateralThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        Image gridResult;
+        Image exactResult;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        if (!source.bilateralFilter(gridResult, spatialSigma, rangeSigma, bilateralThreads,
+                                    BilateralAlgorithm::GRID)) {
+            return 1;
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        if (!source.bilateralFilter(exactResult, spatialSigma, rangeSigma, bilateralThreads,
+                                    BilateralAlgorithm::BRUTE_FORCE)) {
+            return 1;
+        }
+        auto t3 = std::chrono::high_resolution_clock::now();
+
+        // Quality on the 8 bit scale of the saved images
+        std::vector<float> gridPixels = gridResult.getImage();
+        std::vector<float> exactPixels = exactResult.getImage();
+        float maxDifference = 0;
+        double squaredError = 0;
+        for (unsigned int i = 0; i < gridPixels.size(); i++) {
+            float difference = std::abs(gridPixels[i] - exactPixels[i]);
+            maxDifference = std::max(maxDifference, difference);
+            squaredError += difference * difference;
+        }
+        double meanSquaredError = squaredError / std::max(static_cast<double>(gridPixels.size()), 1.0);
+        double psnr = 10 * log10(255.0 * 255.0 / std::max(meanSquaredError, 1e-12));
+
+        auto gridDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+        auto exactDuration = std::chrono::duration_cast<std::chrono::microseconds>(t3 - t2).count();
+        std::cout << "Grid " << gridDuration << " μs, brute force " << exactDuration
+                  << " μs, speedup "
+                  << static_cast<double>(exactDuration) / std::max(static_cast<double>(gridDuration), 1.0)
+                  << std::endl;
+        std::cout << "Max difference " << maxDifference << ", PSNR " << psnr << " dB" << std::endl;
+
+        gridResult.saveImage(std::string(std::string(OUTPUT_FOLDER) + "1_" + BILATERAL_COMMAND +
+                                        std::string(IMAGE_EXT)).c_str());
+
+        return 0;
+    }
+
+    // Chain mode: lazy tile-fused stages, compared with the eager chain
+    if (argc > 4 && std::string(argv[1]) == CHAIN_COMMAND) {
+        Image source;
+        if (!source.loadImage(argv[2])) {
+            return 1;
+        }
+
+        FilterOptions options;
+        options.threadsNumber = atoi(argv[3]);
+
+        // Stages are filter names or clamp:min:max
+        LazyImage chain(source);
+        std::vector<Kernel> kernels;
+        for (int i = 4; i < argc; i++) {
+            std::string stage = argv[i];
+            float minValue = 0;
+            float maxValue = 0;
+            if (stage.compare(0, std::string(CHAIN_CLAMP_STAGE).size(), CHAIN_CLAMP_STAGE) == 0) {
+                if (sscanf(stage.c_str(), CHAIN_CLAMP_STAGE ":%f:%f", &minValue, &maxValue) != 2) {
+                    std::cerr << "Invalid clamp stage " << stage << std::endl;
+                    return 1;
+                }
+                chain.clamp(minValue, maxValue);
+                continue;
+            }
+
+            Kernel kernel;
+            if (!kernel.setFilter(stage)) {
+                std::cerr << "Invalid filter type " << stage << std::endl;
+                return 1;
+            }
+            chain.filter(kernel, stage);
+        }
+
+        Image lazyResult;
+        if (!chain.evaluate(lazyResult, options)) {
+            return 1;
+        }
+
+        // Eager chain: every stage writes a whole image
+        auto t1 = std::chrono::high_resolution_clock::now();
+        Image eagerResult = source;
+        for (const LazyStage& stage : chain.getStages()) {
+            if (stage.operation == LazyOperation::FILTER) {
+                Image filtered;
+                eagerResult.multithreadFiltering(filtered, stage.kernel, options);
+                eagerResult = filtered;
+                continue;
+            }
+            std::vector<float> pixels = eagerResult.getImage();
+            for (unsigned int i = 0; i < pixels.size(); i++) {
+                pixels[i] = std::min(std::max(pixels[i], stage.minValue), stage.maxValue);
+            }
+            eagerResult.setImage(pixels, eagerResult.getImageWidth(), eagerResult.getImageHeight());
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        auto eagerDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+        std::cout << "Eager chain execution time: " << eagerDuration << " μs" << std::endl;
+
+        std::vector<float> lazyPixels = lazyResult.getImage();
+        std::vector<float> eagerPixels = eagerResult.getImage();
+        float maxDifference = 0;
+        for (unsigned int i = 0; i < lazyPixels.size(); i++) {
+            maxDifference = std::max(maxDifference, std::abs(lazyPixels[i] - eagerPixels[i]));
+        }
+        std::cout << "Max difference from eager chain: " << maxDifference << std::endl;
+
+        lazyResult.saveImage(std::string(std::string(OUTPUT_FOLDER) + "1_" + CHAIN_COMMAND +
+                                            std::string(IMAGE_EXT)).c_str());
+
+        return 0;
+    }
+
     // Check command line parameters
     if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " filter_type image_path threads_number" << std::endl;
-        std::cerr << "filter_type: <gaussian | sharpen | edge_detect | laplacian | gaussian_laplacian>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " filter_type image_path threads_number block_size" << std::endl;
+        std::cerr << "filter_type: <gaussian | sharpen | edge_detect | laplacian | gaussian_laplacian | pyramid>" << std::endl;
         std::cerr << "image_path: specify the image path" << std::endl;
-        std::cerr << "(optional) threads_number: number of threads for the parallel run. Default: 4" << std::endl;
+        std::cerr << "(optional) threads_number: number of threads for the parallel run. Default: from tuning profile" << std::endl;
+        std::cerr << "(optional) block_size: store the image in square blocks of this side. Default: row-major" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " tune max_threads" << std::endl;
+        std::cerr << "(optional) max_threads: largest threads number to be measured. Default: hardware threads" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <check | check_baseline> tolerance max_slowdown" << std::endl;
+        std::cerr << "(optional) tolerance: max difference from golden outputs in 8 bit levels. Default: 1" << std::endl;
+        std::cerr << "(optional) max_slowdown: max throughput drop below baseline in percent. Default: 10" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " serve socket_path threads_number" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " submit socket_path <filter_type input output | shutdown>" << std::endl;
+        std::cerr << "input, output: png path or shared memory handle shm:/name:WIDTHxHEIGHT" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <median | median_bench> image_path radius threads_number" << std::endl;
+        std::cerr << "(optional) radius: median window radius, the largest one for median_bench. Default: 2, 16" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " morphology <erode | dilate | open | close> image_path element_width element_height threads_number filter_type" << std::endl;
+        std::cerr << "(optional) filter_type: filter applied before the morphology operation" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " gradient <sobel | scharr> <l1 | l2> image_path threads_number orientation_bins" << std::endl;
+        std::cerr << "(optional) orientation_bins: number of orientation bins, 0 for magnitude only. Default: 0" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " bilateral image_path spatial_sigma range_sigma threads_number" << std::endl;
+        std::cerr << "(optional) spatial_sigma, range_sigma: in pixels and gray levels. Default: 4, 20" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " chain image_path threads_number stage..." << std::endl;
+        std::cerr << "stage: filter_type or clamp:min:max, run lazily tile by tile" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " shard filter_type image_path processes_number <shm | stream>" << std::endl;
+        std::cerr << "(optional) processes_number: number of worker processes. Default: hardware threads" << std::endl;
+        std::cerr << "(optional) transport: shared memory segment or serialized stream. Default: shm" << std::endl;
         return 1;
     }
 
@@ -45,6 +466,17 @@ int main(int argc, char *argv[])
         }
     }
 
+    int blockSize = 0;
+    if (argc > 4) {
+        blockSize = atoi(argv[4]);
+    }
+
+    // Threads for the stages not covered by the tuning profile
+    int workersNumber = threadsNumber;
+    if (workersNumber <= 0) {
+        workersNumber = std::max(1u, std::thread::hardware_concurrency());
+    }
+
     FilterType filterType;
     std::string cmdFilter = std::string(argv[1]);
     if (cmdFilter == GAUSSIAN_FILTER_COMMAND) {
@@ -62,46 +494,57 @@ int main(int argc, char *argv[])
     else if (cmdFilter == GAUSSIAN_LAPLACIAN_COMMAND) {
         filterType = FilterType::GAUSSIAN_LAPLACIAN_FILTER;
     }
+    else if (cmdFilter == GAUSSIAN_PYRAMID_COMMAND) {
+        filterType = FilterType::GAUSSIAN_PYRAMID;
+    }
     else {
         std::cerr << "Invalid filter type " << cmdFilter << std::endl;
-        std::cerr << "filter_type: <gaussian | sharpen | edge_detect | laplacian | gaussian_laplacian >" << std::endl;
+        std::cerr << "filter_type: <gaussian | sharpen | edge_detect | laplacian | gaussian_laplacian | pyramid >" << std::endl;
         return 1;
     }
 
     Kernel filter = Kernel();
     switch (filterType)
     {
-        case FilterType::GAUSSIAN_FILTER:
-            filter.setGaussianFilter(7, 7, 1);
-            break;
-
-        case FilterType::SHARPEN_FILTER:
-            filter.setSharpenFilter();
-            break;
-
-        case FilterType::EDGE_DETECTION:
-            filter.setEdgeDetectionFilter();
-            break;
-
-        case FilterType::LAPLACIAN_FILTER:
-            filter.setLaplacianFilter();
-            break;
-
-        case FilterType::GAUSSIAN_LAPLACIAN_FILTER:
-            filter.setGaussianLaplacianFilter();
+        case FilterType::GAUSSIAN_PYRAMID:
+            filter.setGaussianFilter(5, 5, 1);
             break;
 
         default:
-            std::cerr << "Unable to find requested filter, switching to gaussian..." << std::endl;
-            filter.setGaussianFilter(5, 5, 2);
+            filter.setFilter(cmdFilter);
             break;
     }
     filter.printKernel();
 
-    // Getting images from source folder
+    // Getting images from source folder, stored in blocks if requested
     std::vector<Image*> images;
     images.push_back(new Image());
+    if (blockSize > 0) {
+        images[0]->setLayout(ImageLayout::TILED, blockSize);
+    }
     images[0]->loadImage(argv[2]);
+
+    // Pyramid levels are saved one per file, no sequential run
+    if (filterType == FilterType::GAUSSIAN_PYRAMID) {
+        std::vector<Image*> levels;
+        for (int l = 0; l < PYRAMID_LEVELS; l++) {
+            levels.push_back(new Image());
+        }
+
+        bool result = images[0]->buildGaussianPyramid(levels, filter, workersNumber);
+
+        for (unsigned int l = 0; l < levels.size(); l++) {
+            if (result) {
+                levels[l]->saveImage(std::string(std::string(OUTPUT_FOLDER) + 
+                                        "1_" + cmdFilter + "_" + std::to_string(l + 1) +
+                                        std::string(IMAGE_EXT)).c_str());
+            }
+            delete levels[l];
+        }
+        delete images[0];
+
+        return result ? 0 : 1;
+    }
     
     std::vector<Image*> resultingMTImages;
     std::vector<Image*> resultingNPImages;
@@ -131,15 +574,18 @@ int main(int argc, char *argv[])
     auto singleDuration = std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3).count();
 
     std::cout << "Multithread Execution time: " << multithreadDuration
-              << " with threads: " << threadsNumber << std::endl;
+              << " with threads: " << (threadsNumber > 0 ? std::to_string(threadsNumber) : "auto") 
+              << std::endl;
 
     std::cout << "Single thread Execution time: " << singleDuration << std::endl;
 
-    // Saving resulting images
+    // Saving resulting images, deflating strips with the same threads number
+    PngSettings pngSettings;
+    pngSettings.threadsNumber = workersNumber;
     for (unsigned int i = 0; i < resultingMTImages.size(); i++) {
         resultingMTImages[i]->saveImage(std::string(std::string(OUTPUT_FOLDER) + 
                                         std::to_string(i + 1) + "_" + cmdFilter +
-                                        std::string(IMAGE_EXT)).c_str());
+                                        std::string(IMAGE_EXT)).c_str(), pngSettings);
     }
 
     for (unsigned int i = 0; i < images.size(); i++) {
@@ -0,0 +1,226 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+#include "image.h"
+
+
+#define MEDIAN_COARSE_BINS  16
+#define MEDIAN_FINE_BINS    256
+#define MEDIAN_SEGMENT_BINS (MEDIAN_FINE_BINS / MEDIAN_COARSE_BINS)
+
+/*
+ * @brief: Data shared by the median threads
+ */
+struct MedianData
+{
+    const unsigned char* paddedImage8;  ///< 8 bit padded matrix, HISTOGRAM only
+    const float* paddedImage;           ///< Replicate padded source matrix
+    float* outImage;                    ///< Output matrix
+    int width;                          ///< Output width
+    int radius;                         ///< Window radius
+};
+
+void threadMedianHistogram(const MedianData* data, int startLine, int stopLine);
+
+void threadMedianSort(const MedianData* data, int startLine, int stopLine);
+
+void threadMedianHistogram(const MedianData* data, int startLine, int stopLine)
+{
+    int side = 2 * data->radius + 1;
+    int width = data->width;
+    int paddedWidth = width + side - 1;
+    int rank = side * side / 2;
+    const unsigned char* paddedImage = data->paddedImage8;
+
+    // Column histograms of the band, every one covering the window rows:
+    // fine bins are the 8 bit values, coarse bins their 4 high bits
+    std::vector<uint16_t> columnFine(paddedWidth * MEDIAN_FINE_BINS, 0);
+    std::vector<uint16_t> columnCoarse(paddedWidth * MEDIAN_COARSE_BINS, 0);
+
+    int kernelCoarse[MEDIAN_COARSE_BINS];
+    int kernelFine[MEDIAN_FINE_BINS];
+    int lastUpdate[MEDIAN_COARSE_BINS];        ///< Window column of the last fine segment update
+
+    for (int h = startLine; h < startLine + side - 1; h++) {
+        const unsigned char* row = paddedImage + h * paddedWidth;
+        for (int c = 0; c < paddedWidth; c++) {
+            columnFine[c * MEDIAN_FINE_BINS + row[c]]++;
+            columnCoarse[c * MEDIAN_COARSE_BINS + row[c] / MEDIAN_SEGMENT_BINS]++;
+        }
+    }
+
+    for (int l = startLine; l < stopLine; l++) {
+        // Slide the column histograms down by one row
+        const unsigned char* inRow = paddedImage + (l + side - 1) * paddedWidth;
+        const unsigned char* outRow = l > startLine ? paddedImage + (l - 1) * paddedWidth : NULL;
+        for (int c = 0; c < paddedWidth; c++) {
+            if (outRow != NULL) {
+                columnFine[c * MEDIAN_FINE_BINS + outRow[c]]--;
+                columnCoarse[c * MEDIAN_COARSE_BINS + outRow[c] / MEDIAN_SEGMENT_BINS]--;
+            }
+            columnFine[c * MEDIAN_FINE_BINS + inRow[c]]++;
+            columnCoarse[c * MEDIAN_COARSE_BINS + inRow[c] / MEDIAN_SEGMENT_BINS]++;
+        }
+
+        // Coarse window histogram of the first column, fine segments
+        // are built only when the median falls in them
+        std::fill(kernelCoarse, kernelCoarse + MEDIAN_COARSE_BINS, 0);
+        for (int c = 0; c < side; c++) {
+            for (int k = 0; k < MEDIAN_COARSE_BINS; k++) {
+                kernelCoarse[k] += columnCoarse[c * MEDIAN_COARSE_BINS + k];
+            }
+        }
+        std::fill(lastUpdate, lastUpdate + MEDIAN_COARSE_BINS, -side);
+
+        float* outImageRow = data->outImage + l * width;
+        for (int x = 0; x < width; x++) {
+            if (x > 0) {
+                const uint16_t* added = columnCoarse.data() + (x + side - 1) * MEDIAN_COARSE_BINS;
+                const uint16_t* removed = columnCoarse.data() + (x - 1) * MEDIAN_COARSE_BINS;
+                for (int k = 0; k < MEDIAN_COARSE_BINS; k++) {
+                    kernelCoarse[k] += added[k] - removed[k];
+                }
+            }
+
+            int sum = 0;
+            int k = 0;
+            while (sum + kernelCoarse[k] <= rank) {
+                sum += kernelCoarse[k];
+                k++;
+            }
+
+            // Bring the fine segment k up to the current window, by
+            // sliding it or rebuilding it when that is cheaper
+            int* fine = kernelFine + k * MEDIAN_SEGMENT_BINS;
+            if (2 * (x - lastUpdate[k]) > side) {
+                std::fill(fine, fine + MEDIAN_SEGMENT_BINS, 0);
+                for (int c = x; c < x + side; c++) {
+                    const uint16_t* column = columnFine.data() + c * MEDIAN_FINE_BINS + k * MEDIAN_SEGMENT_BINS;
+                    for (int b = 0; b < MEDIAN_SEGMENT_BINS; b++) {
+                        fine[b] += column[b];
+                    }
+                }
+            }
+            else {
+                for (int c = lastUpdate[k] + 1; c <= x; c++) {
+                    const uint16_t* added = columnFine.data() + (c + side - 1) * MEDIAN_FINE_BINS + k * MEDIAN_SEGMENT_BINS;
+                    const uint16_t* removed = columnFine.data() + (c - 1) * MEDIAN_FINE_BINS + k * MEDIAN_SEGMENT_BINS;
+                    for (int b = 0; b < MEDIAN_SEGMENT_BINS; b++) {
+                        fine[b] += added[b] - removed[b];
+                    }
+                }
+            }
+            lastUpdate[k] = x;
+
+            int b = 0;
+            while (sum + fine[b] <= rank) {
+                sum += fine[b];
+                b++;
+            }
+            outImageRow[x] = static_cast<float>(k * MEDIAN_SEGMENT_BINS + b);
+        }
+    }
+}
+
+void threadMedianSort(const MedianData* data, int startLine, int stopLine)
+{
+    int side = 2 * data->radius + 1;
+    int width = data->width;
+    int paddedWidth = width + side - 1;
+    int rank = side * side / 2;
+    std::vector<float> window(side * side);
+
+    for (int l = startLine; l < stopLine; l++) {
+        for (int x = 0; x < width; x++) {
+            for (int h = 0; h < side; h++) {
+                const float* row = data->paddedImage + (l + h) * paddedWidth + x;
+                std::copy(row, row + side, window.begin() + h * side);
+            }
+            std::nth_element(window.begin(), window.begin() + rank, window.end());
+            data->outImage[l * width + x] = window[rank];
+        }
+    }
+}
+
+bool Image::medianFilter(Image& resultingImage, int radius, int threadsNumber,
+                            MedianAlgorithm algorithm) const
+{
+    std::cout << "Applying median filter to image" << std::endl;
+
+    // Get image dimensions
+    int height = this->getImageHeight();
+    int width = this->getImageWidth();
+
+    if (radius < 0 || threadsNumber <= 0) {
+        std::cerr << "Invalid median parameters" << std::endl;
+        return false;
+    }
+
+    // Input padding w.r.t. window size
+    auto t1 = std::chrono::high_resolution_clock::now();
+    std::vector<float> paddedImage = buildClampedPaddedImage(radius, radius);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto paddingDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    std::cout << "Padding Execution time: " << paddingDuration << " μs" << std::endl;
+
+    // Histograms need 8 bit values, as loaded from png
+    std::vector<unsigned char> paddedImage8;
+    if (algorithm == MedianAlgorithm::HISTOGRAM) {
+        paddedImage8.resize(paddedImage.size());
+        for (unsigned int i = 0; i < paddedImage.size(); i++) {
+            float value = paddedImage[i];
+            if (value < 0 || value > 255 || value != floor(value)) {
+                std::cerr << "Image values are not 8 bit, using sort median" << std::endl;
+                algorithm = MedianAlgorithm::SORT;
+                break;
+            }
+            paddedImage8[i] = static_cast<unsigned char>(value);
+        }
+    }
+
+    std::cout << "Algorithm: " << (algorithm == MedianAlgorithm::HISTOGRAM ? "histogram" : "sort")
+              << ", radius: " << radius << ", threads: " << threadsNumber << std::endl;
+
+    std::vector<float> newImage(height * width);
+
+    MedianData data;
+    data.paddedImage8 = paddedImage8.data();
+    data.paddedImage = paddedImage.data();
+    data.outImage = newImage.data();
+    data.width = width;
+    data.radius = radius;
+
+    void (*median)(const MedianData*, int, int) = algorithm == MedianAlgorithm::HISTOGRAM ?
+                                                    threadMedianHistogram : threadMedianSort;
+
+    t1 = std::chrono::high_resolution_clock::now();
+
+    // Same row bands as multithreadFiltering, a single one in the caller
+    std::vector<std::thread> threads;
+    if (threadsNumber == 1) {
+        median(&data, 0, height);
+    }
+    else {
+        int bandsNumber = std::min(threadsNumber, std::max(height, 1));
+        for (int i = 0; i < bandsNumber; i++) {
+            int startLine = height / bandsNumber * i;
+            int stopLine = i == bandsNumber - 1 ? height : height / bandsNumber * (i + 1);
+            threads.push_back(std::thread(median, &data, startLine, stopLine));
+        }
+    }
+    for (unsigned int i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    t2 = std::chrono::high_resolution_clock::now();
+    auto filterDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    std::cout << "Median filtering execution time: " << filterDuration << " μs" << std::endl;
+
+    resultingImage.setImage(newImage, width, height);
+
+    std::cout << "Done!" << std::endl;
+
+    return true;
+}
@@ -0,0 +1,239 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include "image.h"
+
+
+#define MORPHOLOGY_COLUMNS_CHUNK    64
+
+/*
+ * @brief: Data shared by the threads of a morphology pass
+ */
+struct MorphologyData
+{
+    const float* source;            ///< Pass input matrix
+    float* outImage;                ///< Pass output matrix
+    int width;                      ///< Matrix width
+    int height;                     ///< Matrix height
+    int elementSize;                ///< Element side along the pass direction
+    int anchor;                     ///< Element pixels before the output pixel
+};
+
+/*
+ * @brief: Erosion operator, neutral is the value of pixels outside the image
+ */
+struct MinOperator
+{
+    static float neutral() { return std::numeric_limits<float>::infinity(); }
+    static float apply(float a, float b) { return std::min(a, b); }
+};
+
+/*
+ * @brief: Dilation operator
+ */
+struct MaxOperator
+{
+    static float neutral() { return -std::numeric_limits<float>::infinity(); }
+    static float apply(float a, float b) { return std::max(a, b); }
+};
+
+template <typename Operator>
+void threadMorphologyRows(const MorphologyData* data, int startLine, int stopLine);
+
+template <typename Operator>
+void threadMorphologyColumns(const MorphologyData* data, int startColumn, int stopColumn);
+
+template <typename Operator>
+void threadMorphologyRows(const MorphologyData* data, int startLine, int stopLine)
+{
+    int k = data->elementSize;
+    int width = data->width;
+
+    // Padded line: the element of output i covers padded[i, i + k),
+    // split in k wide segments with prefix (g) and suffix (h) extrema
+    int paddedLength = (width + k - 1 + k - 1) / k * k;
+    std::vector<float> padded(paddedLength, Operator::neutral());
+    std::vector<float> g(paddedLength);
+    std::vector<float> h(paddedLength);
+
+    for (int l = startLine; l < stopLine; l++) {
+        const float* sourceRow = data->source + l * width;
+        std::copy(sourceRow, sourceRow + width, padded.begin() + data->anchor);
+
+        for (int j = 0; j < paddedLength; j++) {
+            g[j] = j % k == 0 ? padded[j] : Operator::apply(g[j - 1], padded[j]);
+        }
+        for (int j = paddedLength - 1; j >= 0; j--) {
+            h[j] = (j % k == k - 1) ? padded[j] : Operator::apply(h[j + 1], padded[j]);
+        }
+
+        float* outRow = data->outImage + l * width;
+        for (int i = 0; i < width; i++) {
+            outRow[i] = Operator::apply(h[i], g[i + k - 1]);
+        }
+    }
+}
+
+template <typename Operator>
+void threadMorphologyColumns(const MorphologyData* data, int startColumn, int stopColumn)
+{
+    int k = data->elementSize;
+    int width = data->width;
+    int height = data->height;
+    int paddedLength = (height + k - 1 + k - 1) / k * k;
+
+    // Columns are processed in chunks, whole rows of the chunk at a time,
+    // so that the inner loops have unit stride
+    std::vector<float> neutralRow(MORPHOLOGY_COLUMNS_CHUNK, Operator::neutral());
+    std::vector<float> g(paddedLength * MORPHOLOGY_COLUMNS_CHUNK);
+    std::vector<float> h(paddedLength * MORPHOLOGY_COLUMNS_CHUNK);
+
+    for (int c = startColumn; c < stopColumn; c += MORPHOLOGY_COLUMNS_CHUNK) {
+        int chunk = std::min(MORPHOLOGY_COLUMNS_CHUNK, stopColumn - c);
+
+        for (int j = 0; j < paddedLength; j++) {
+            int l = j - data->anchor;
+            const float* padded = (l >= 0 && l < height) ? data->source + l * width + c :
+                                                            neutralRow.data();
+            float* gRow = g.data() + j * MORPHOLOGY_COLUMNS_CHUNK;
+            if (j % k == 0) {
+                std::copy(padded, padded + chunk, gRow);
+                continue;
+            }
+            const float* gPrevious = gRow - MORPHOLOGY_COLUMNS_CHUNK;
+            for (int x = 0; x < chunk; x++) {
+                gRow[x] = Operator::apply(gPrevious[x], padded[x]);
+            }
+        }
+
+        for (int j = paddedLength - 1; j >= 0; j--) {
+            int l = j - data->anchor;
+            const float* padded = (l >= 0 && l < height) ? data->source + l * width + c :
+                                                            neutralRow.data();
+            float* hRow = h.data() + j * MORPHOLOGY_COLUMNS_CHUNK;
+            if (j % k == k - 1) {
+                std::copy(padded, padded + chunk, hRow);
+                continue;
+            }
+            const float* hNext = hRow + MORPHOLOGY_COLUMNS_CHUNK;
+            for (int x = 0; x < chunk; x++) {
+                hRow[x] = Operator::apply(hNext[x], padded[x]);
+            }
+        }
+
+        for (int i = 0; i < height; i++) {
+            const float* hRow = h.data() + i * MORPHOLOGY_COLUMNS_CHUNK;
+            const float* gRow = g.data() + (i + k - 1) * MORPHOLOGY_COLUMNS_CHUNK;
+            float* outRow = data->outImage + i * width + c;
+            for (int x = 0; x < chunk; x++) {
+                outRow[x] = Operator::apply(hRow[x], gRow[x]);
+            }
+        }
+    }
+}
+
+/*
+ * @brief: run a pass splitting rows (or columns) in bands among threads
+ */
+static void runMorphologyPass(void (*pass)(const MorphologyData*, int, int),
+                                const MorphologyData& data, int linesNumber, int threadsNumber)
+{
+    if (threadsNumber == 1) {
+        pass(&data, 0, linesNumber);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    int bandsNumber = std::min(threadsNumber, std::max(linesNumber, 1));
+    for (int i = 0; i < bandsNumber; i++) {
+        int startLine = linesNumber / bandsNumber * i;
+        int stopLine = i == bandsNumber - 1 ? linesNumber : linesNumber / bandsNumber * (i + 1);
+        threads.push_back(std::thread(pass, &data, startLine, stopLine));
+    }
+    for (unsigned int i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+}
+
+/*
+ * @brief: erosion or dilation of source into outImage, through buffer
+ */
+static void runMorphology(bool dilation, const float* source, float* buffer, float* outImage,
+                            int width, int height, int elementWidth, int elementHeight,
+                            int threadsNumber)
+{
+    // Dilation uses the reflected element, so that opening and
+    // closing are correct for even sides too
+    MorphologyData rows;
+    rows.source = source;
+    rows.outImage = buffer;
+    rows.width = width;
+    rows.height = height;
+    rows.elementSize = elementWidth;
+    rows.anchor = dilation ? elementWidth / 2 : (elementWidth - 1) / 2;
+    runMorphologyPass(dilation ? threadMorphologyRows<MaxOperator> : threadMorphologyRows<MinOperator>,
+                        rows, height, threadsNumber);
+
+    MorphologyData columns = rows;
+    columns.source = buffer;
+    columns.outImage = outImage;
+    columns.elementSize = elementHeight;
+    columns.anchor = dilation ? elementHeight / 2 : (elementHeight - 1) / 2;
+    runMorphologyPass(dilation ? threadMorphologyColumns<MaxOperator> : threadMorphologyColumns<MinOperator>,
+                        columns, width, threadsNumber);
+}
+
+bool Image::morphologyFilter(Image& resultingImage, MorphologyOperation operation,
+                                int elementWidth, int elementHeight, int threadsNumber) const
+{
+    std::cout << "Applying morphology filter to image" << std::endl;
+
+    // Get image dimensions
+    int height = this->getImageHeight();
+    int width = this->getImageWidth();
+
+    if (elementWidth <= 0 || elementHeight <= 0 || threadsNumber <= 0) {
+        std::cerr << "Invalid morphology parameters" << std::endl;
+        return false;
+    }
+
+    std::cout << "Element: " << elementWidth << "x" << elementHeight
+              << ", threads: " << threadsNumber << std::endl;
+
+    // Passes move between the output and a single buffer
+    std::vector<float> rowMajorImage;
+    if (m_layout == ImageLayout::TILED) {
+        rowMajorImage = getImage();
+    }
+    const float* source = m_layout == ImageLayout::TILED ? rowMajorImage.data() : m_image.data();
+    std::vector<float> buffer(height * width);
+    std::vector<float> newImage(height * width);
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    switch (operation)
+    {
+        case MorphologyOperation::EROSION:
+        case MorphologyOperation::DILATION:
+            runMorphology(operation == MorphologyOperation::DILATION, source, buffer.data(),
+                            newImage.data(), width, height, elementWidth, elementHeight, threadsNumber);
+            break;
+
+        case MorphologyOperation::OPENING:
+        case MorphologyOperation::CLOSING:
+            runMorphology(operation == MorphologyOperation::CLOSING, source, buffer.data(),
+                            newImage.data(), width, height, elementWidth, elementHeight, threadsNumber);
+            runMorphology(operation == MorphologyOperation::OPENING, newImage.data(), buffer.data(),
+                            newImage.data(), width, height, elementWidth, elementHeight, threadsNumber);
+            break;
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto filterDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    std::cout << "Morphology filtering execution time: " << filterDuration << " μs" << std::endl;
+
+    resultingImage.setImage(newImage, width, height);
+
+    std::cout << "Done!" << std::endl;
+
+    return true;
+}
@@ -0,0 +1,466 @@
+#include <png.h>
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "pngio.h"
+
+
+#define PNG_GRAY_BIT_DEPTH      8
+#define DEFLATE_WINDOW_SIZE     32768
+
+/*
+ * @brief: A horizontal strip of the image deflated by a single thread
+ */
+struct PngStrip
+{
+    int startLine;
+    int stopLine;
+    std::vector<unsigned char> data;    ///< Raw deflate output
+    unsigned long adler;                ///< Adler32 of the strip filtered rows
+    bool result;
+};
+
+void threadFilterRows(const float* pixels, int width, int startLine, int stopLine,
+                        PngFilter filter, unsigned char* filteredImage);
+
+void threadDeflateStrip(const unsigned char* filteredImage, int rowLength,
+                        int compressionLevel, bool lastStrip, PngStrip* strip);
+
+bool readGrayPng(const char* filename, std::vector<float>& pixels, int& width, int& height)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        std::cerr << "Unable to open " << std::string(filename) << std::endl;
+        return false;
+    }
+
+    unsigned char signature[8];
+    if (fread(signature, 1, sizeof(signature), file) != sizeof(signature) ||
+            png_sig_cmp(signature, 0, sizeof(signature)) != 0) {
+        std::cerr << "Not a png file: " << std::string(filename) << std::endl;
+        fclose(file);
+        return false;
+    }
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+    if (png == NULL || info == NULL) {
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(file);
+        return false;
+    }
+
+    // Buffers are declared before setjmp, so that they are released on error
+    std::vector<unsigned char> rows;
+    std::vector<png_bytep> rowPtrs;
+
+    if (setjmp(png_jmpbuf(png))) {
+        std::cerr << "Error while reading " << std::string(filename) << std::endl;
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(file);
+        return false;
+    }
+
+    png_init_io(png, file);
+    png_set_sig_bytes(png, sizeof(signature));
+    png_read_info(png, info);
+
+    int colorType = png_get_color_type(png, info);
+    int bitDepth = png_get_bit_depth(png, info);
+
+    // Let libpng convert any format to 8 bit gray
+    if (bitDepth == 16) {
+        png_set_strip_16(png);
+    }
+    if (colorType & PNG_COLOR_MASK_ALPHA) {
+        png_set_strip_alpha(png);
+    }
+    if (colorType == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(png);
+    }
+    if (colorType == PNG_COLOR_TYPE_GRAY && bitDepth < 8) {
+        png_set_expand_gray_1_2_4_to_8(png);
+    }
+    if (colorType & PNG_COLOR_MASK_COLOR) {
+        png_set_rgb_to_gray(png, PNG_ERROR_ACTION_NONE, -1, -1);
+    }
+    int passes = png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    width = png_get_image_width(png, info);
+    height = png_get_image_height(png, info);
+    pixels.resize(static_cast<size_t>(width) * height);
+
+    if (passes == 1) {
+        // Decode one row at a time straight into the matrix
+        rows.resize(width);
+        png_bytep rowPtr = rows.data();
+        for (int h = 0; h < height; h++) {
+            png_read_row(png, rowPtr, NULL);
+            float* outRow = pixels.data() + static_cast<size_t>(h) * width;
+            for (int w = 0; w < width; w++) {
+                outRow[w] = rowPtr[w];
+            }
+        }
+    }
+    else {
+        // Interlaced images need all the rows for every pass
+        rows.resize(static_cast<size_t>(width) * height);
+        rowPtrs.resize(height);
+        for (int h = 0; h < height; h++) {
+            rowPtrs[h] = rows.data() + static_cast<size_t>(h) * width;
+        }
+        png_read_image(png, rowPtrs.data());
+        for (size_t i = 0; i < rows.size(); i++) {
+            pixels[i] = rows[i];
+        }
+    }
+
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+    fclose(file);
+
+    return true;
+}
+
+/*
+ * @brief: convert a row of values to 8 bit, truncating as an implicit
+ *          float to png_byte conversion does
+ */
+static void quantizeRow(const float* source, unsigned char* dest, int width)
+{
+    for (int w = 0; w < width; w++) {
+        float value = source[w];
+        if (value < 0) {
+            value = 0;
+        }
+        else if (value > 255) {
+            value = 255;
+        }
+        dest[w] = static_cast<unsigned char>(value);
+    }
+}
+
+static bool writeGrayPngSequential(FILE* file, const float* pixels, int width, int height,
+                                    const PngSettings& settings)
+{
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+    if (png == NULL || info == NULL) {
+        png_destroy_write_struct(&png, &info);
+        return false;
+    }
+
+    std::vector<unsigned char> row(width);
+
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        return false;
+    }
+
+    int filters = PNG_ALL_FILTERS;
+    switch (settings.filter)
+    {
+        case PngFilter::NONE:       filters = PNG_FILTER_NONE; break;
+        case PngFilter::SUB:        filters = PNG_FILTER_SUB; break;
+        case PngFilter::UP:         filters = PNG_FILTER_UP; break;
+        case PngFilter::AVERAGE:    filters = PNG_FILTER_AVG; break;
+        case PngFilter::PAETH:      filters = PNG_FILTER_PAETH; break;
+        default:                    filters = PNG_ALL_FILTERS; break;
+    }
+
+    png_init_io(png, file);
+    png_set_IHDR(png, info, width, height, PNG_GRAY_BIT_DEPTH, PNG_COLOR_TYPE_GRAY,
+                    PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_set_compression_level(png, settings.compressionLevel);
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, filters);
+    png_write_info(png, info);
+
+    for (int h = 0; h < height; h++) {
+        quantizeRow(pixels + static_cast<size_t>(h) * width, row.data(), width);
+        png_write_row(png, row.data());
+    }
+
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+
+    return true;
+}
+
+static unsigned char paethPredictor(int left, int up, int upLeft)
+{
+    int p = left + up - upLeft;
+    int pLeft = abs(p - left);
+    int pUp = abs(p - up);
+    int pUpLeft = abs(p - upLeft);
+
+    if (pLeft <= pUp && pLeft <= pUpLeft) {
+        return left;
+    }
+    if (pUp <= pUpLeft) {
+        return up;
+    }
+    return upLeft;
+}
+
+/*
+ * @brief: filter a row with the given PNG filter. out[0] receives the filter type
+ *
+ * @return: sum of the absolute values of the filtered bytes taken as signed
+ */
+static unsigned long filterRow(PngFilter filter, const unsigned char* row,
+                                const unsigned char* prior, int width, unsigned char* out)
+{
+    unsigned long sum = 0;
+
+    out[0] = static_cast<unsigned char>(filter);
+    for (int w = 0; w < width; w++) {
+        int left = w > 0 ? row[w - 1] : 0;
+        int up = prior != NULL ? prior[w] : 0;
+        int upLeft = (prior != NULL && w > 0) ? prior[w - 1] : 0;
+        int predictor = 0;
+
+        switch (filter)
+        {
+            case PngFilter::SUB:        predictor = left; break;
+            case PngFilter::UP:         predictor = up; break;
+            case PngFilter::AVERAGE:    predictor = (left + up) >> 1; break;
+            case PngFilter::PAETH:      predictor = paethPredictor(left, up, upLeft); break;
+            default:                    predictor = 0; break;
+        }
+
+        unsigned char value = static_cast<unsigned char>(row[w] - predictor);
+        out[w + 1] = value;
+        sum += value < 128 ? value : 256 - value;
+    }
+
+    return sum;
+}
+
+void threadFilterRows(const float* pixels, int width, int startLine, int stopLine,
+                        PngFilter filter, unsigned char* filteredImage)
+{
+    int rowLength = width + 1;
+    std::vector<unsigned char> row(width);
+    std::vector<unsigned char> prior(width);
+    std::vector<unsigned char> candidate(rowLength);
+
+    if (startLine > 0) {
+        quantizeRow(pixels + static_cast<size_t>(startLine - 1) * width, prior.data(), width);
+    }
+
+    for (int h = startLine; h < stopLine; h++) {
+        quantizeRow(pixels + static_cast<size_t>(h) * width, row.data(), width);
+        const unsigned char* priorPtr = h > 0 ? prior.data() : NULL;
+        unsigned char* out = filteredImage + static_cast<size_t>(h) * rowLength;
+
+        if (filter == PngFilter::ADAPTIVE) {
+            unsigned long best = filterRow(PngFilter::NONE, row.data(), priorPtr, width, out);
+            const PngFilter candidates[] = { PngFilter::SUB, PngFilter::UP,
+                                             PngFilter::AVERAGE, PngFilter::PAETH };
+            for (PngFilter f : candidates) {
+                unsigned long sum = filterRow(f, row.data(), priorPtr, width, candidate.data());
+                if (sum < best) {
+                    best = sum;
+                    memcpy(out, candidate.data(), rowLength);
+                }
+            }
+        }
+        else {
+            filterRow(filter, row.data(), priorPtr, width, out);
+        }
+
+        row.swap(prior);
+    }
+}
+
+void threadDeflateStrip(const unsigned char* filteredImage, int rowLength,
+                        int compressionLevel, bool lastStrip, PngStrip* strip)
+{
+    size_t start = static_cast<size_t>(strip->startLine) * rowLength;
+    size_t length = static_cast<size_t>(strip->stopLine - strip->startLine) * rowLength;
+
+    strip->result = false;
+    strip->adler = adler32(adler32(0L, Z_NULL, 0), filteredImage + start, length);
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, compressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+
+    // Prime the window with the previous strip, as pigz does,
+    // to not lose matches across strip boundaries
+    if (start > 0) {
+        size_t dictionaryLength = start < DEFLATE_WINDOW_SIZE ? start : DEFLATE_WINDOW_SIZE;
+        deflateSetDictionary(&stream, filteredImage + start - dictionaryLength, dictionaryLength);
+    }
+
+    // Sync flush appends an empty stored block, leave room for it
+    strip->data.resize(deflateBound(&stream, length) + 16);
+    stream.next_in = const_cast<unsigned char*>(filteredImage + start);
+    stream.avail_in = length;
+
+    int flush = lastStrip ? Z_FINISH : Z_SYNC_FLUSH;
+    int ret = Z_OK;
+    size_t produced = 0;
+    do {
+        if (produced == strip->data.size()) {
+            strip->data.resize(strip->data.size() * 2);
+        }
+        stream.next_out = strip->data.data() + produced;
+        stream.avail_out = strip->data.size() - produced;
+        ret = deflate(&stream, flush);
+        produced = strip->data.size() - stream.avail_out;
+    } while (ret == Z_OK && (stream.avail_out == 0 || (lastStrip && ret != Z_STREAM_END)));
+
+    strip->data.resize(produced);
+    deflateEnd(&stream);
+
+    strip->result = lastStrip ? (ret == Z_STREAM_END) : (ret == Z_OK || ret == Z_BUF_ERROR);
+}
+
+static void writeBigEndian(unsigned char* dest, unsigned long value)
+{
+    dest[0] = (value >> 24) & 0xff;
+    dest[1] = (value >> 16) & 0xff;
+    dest[2] = (value >> 8) & 0xff;
+    dest[3] = value & 0xff;
+}
+
+static bool writeChunk(FILE* file, const char* type, const unsigned char* data, size_t length)
+{
+    unsigned char header[8];
+    writeBigEndian(header, length);
+    memcpy(header + 4, type, 4);
+
+    unsigned long crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, header + 4, 4);
+    if (length > 0) {
+        crc = crc32(crc, data, length);
+    }
+    unsigned char trailer[4];
+    writeBigEndian(trailer, crc);
+
+    return fwrite(header, 1, 8, file) == 8 &&
+            (length == 0 || fwrite(data, 1, length, file) == length) &&
+            fwrite(trailer, 1, 4, file) == 4;
+}
+
+static bool writeGrayPngParallel(FILE* file, const float* pixels, int width, int height,
+                                    const PngSettings& settings)
+{
+    int rowLength = width + 1;
+    int stripsNumber = settings.threadsNumber < height ? settings.threadsNumber : height;
+    std::vector<unsigned char> filteredImage(static_cast<size_t>(rowLength) * height);
+    std::vector<PngStrip> strips(stripsNumber);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < stripsNumber; i++) {
+        strips[i].startLine = (height * i) / stripsNumber;
+        strips[i].stopLine = (height * (i + 1)) / stripsNumber;
+    }
+
+    // Filtering reads the previous raw row only, so strips are independent
+    for (int i = 0; i < stripsNumber; i++) {
+        threads.push_back(std::thread(threadFilterRows, pixels, width,
+                                strips[i].startLine, strips[i].stopLine,
+                                settings.filter, filteredImage.data()));
+    }
+    for (unsigned int i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    threads.clear();
+
+    // Deflate needs the filtered previous strip as dictionary
+    for (int i = 0; i < stripsNumber; i++) {
+        threads.push_back(std::thread(threadDeflateStrip, filteredImage.data(), rowLength,
+                                settings.compressionLevel, i == stripsNumber - 1, &strips[i]));
+    }
+    for (unsigned int i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+
+    // zlib header: 32K window, level hint, no preset dictionary
+    int level = settings.compressionLevel;
+    int levelFlag = level < 2 ? 0 : (level < 6 ? 1 : (level == 6 ? 2 : 3));
+    unsigned char zlibHeader[2];
+    zlibHeader[0] = 0x78;
+    zlibHeader[1] = levelFlag << 6;
+    zlibHeader[1] += 31 - ((zlibHeader[0] * 256 + zlibHeader[1]) % 31);
+
+    unsigned long adler = adler32(0L, Z_NULL, 0);
+    for (int i = 0; i < stripsNumber; i++) {
+        if (!strips[i].result) {
+            return false;
+        }
+        size_t length = static_cast<size_t>(strips[i].stopLine - strips[i].startLine) * rowLength;
+        adler = adler32_combine(adler, strips[i].adler, length);
+    }
+
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    unsigned char ihdr[13];
+    writeBigEndian(ihdr, width);
+    writeBigEndian(ihdr + 4, height);
+    ihdr[8] = PNG_GRAY_BIT_DEPTH;
+    ihdr[9] = PNG_COLOR_TYPE_GRAY;
+    ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+    ihdr[11] = PNG_FILTER_TYPE_BASE;
+    ihdr[12] = PNG_INTERLACE_NONE;
+
+    // Every strip goes in its own IDAT chunk: the zlib stream is split
+    // across them, with the header in the first and the checksum in the last
+    strips.front().data.insert(strips.front().data.begin(), zlibHeader, zlibHeader + 2);
+    unsigned char adlerTrailer[4];
+    writeBigEndian(adlerTrailer, adler);
+    strips.back().data.insert(strips.back().data.end(), adlerTrailer, adlerTrailer + 4);
+
+    bool result = fwrite(signature, 1, sizeof(signature), file) == sizeof(signature) &&
+                    writeChunk(file, "IHDR", ihdr, sizeof(ihdr));
+    for (int i = 0; i < stripsNumber && result; i++) {
+        result = writeChunk(file, "IDAT", strips[i].data.data(), strips[i].data.size());
+    }
+
+    return result && writeChunk(file, "IEND", NULL, 0);
+}
+
+bool writeGrayPng(const char* filename, const float* pixels, int width, int height,
+                    const PngSettings& settings)
+{
+    if (width <= 0 || height <= 0) {
+        std::cerr << "Invalid image dimension" << std::endl;
+        return false;
+    }
+
+    if (settings.compressionLevel < 0 || settings.compressionLevel > 9) {
+        std::cerr << "Compression level must be between 0 and 9" << std::endl;
+        return false;
+    }
+
+    FILE* file = fopen(filename, "wb");
+    if (file == NULL) {
+        std::cerr << "Unable to open " << std::string(filename) << std::endl;
+        return false;
+    }
+
+    bool result = false;
+    if (settings.threadsNumber > 1) {
+        result = writeGrayPngParallel(file, pixels, width, height, settings);
+    }
+    else {
+        result = writeGrayPngSequential(file, pixels, width, height, settings);
+    }
+
+    if (fclose(file) != 0) {
+        result = false;
+    }
+
+    if (!result) {
+        std::cerr << "Error while writing " << std::string(filename) << std::endl;
+    }
+
+    return result;
+}
@@ -0,0 +1,60 @@
+#ifndef PNGIO_H
+#define PNGIO_H
+
+#include <vector>
+
+
+/*
+ * @brief: PNG row filter applied before deflate
+ */
+enum class PngFilter
+{
+    NONE,
+    SUB,
+    UP,
+    AVERAGE,
+    PAETH,
+    ADAPTIVE        ///< Per row choice minimizing the sum of absolute differences
+};
+
+/*
+ * @brief: PNG encoding settings
+ */
+struct PngSettings
+{
+    PngSettings() :
+        compressionLevel(6), filter(PngFilter::ADAPTIVE), threadsNumber(1) {}
+
+    int compressionLevel;       ///< zlib compression level, from 0 (store) to 9 (best)
+    PngFilter filter;           ///< Row filter strategy
+    int threadsNumber;          ///< Strips deflated in parallel, 1 uses libpng encoder
+};
+
+/*
+ * @brief: read a png file as a grayscale linearized matrix.
+ *          Color images are converted to gray and alpha is stripped.
+ *
+ * @params[in]: filename: the path of the image to be loaded
+ * @params[out]: pixels: linearized matrix of the pixels' values
+ * @params[out]: width: image width
+ * @params[out]: height: image height
+ * @return: true if successful, false otherwise
+ */
+bool readGrayPng(const char* filename, std::vector<float>& pixels, int& width, int& height);
+
+/*
+ * @brief: write a linearized matrix as an 8 bit grayscale png file.
+ *          With more than one thread the image is split in horizontal strips
+ *          deflated in parallel and concatenated in a single zlib stream.
+ *
+ * @params[in]: filename: the path where to save the image
+ * @params[in]: pixels: linearized matrix of the pixels' values
+ * @params[in]: width: image width
+ * @params[in]: height: image height
+ * @params[in]: settings: encoding settings
+ * @return: true if successful, false otherwise
+ */
+bool writeGrayPng(const char* filename, const float* pixels, int width, int height,
+                    const PngSettings& settings);
+
+#endif
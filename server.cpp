@@ -0,0 +1,507 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <utility>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include "server.h"
+
+
+#define SERVER_RECEIVE_BUFFER   4096
+
+/*
+ * @brief: Stream buffer discarding everything, used to silence the
+ *          operations logs from any pool thread
+ */
+class NullBuffer : public std::streambuf
+{
+    protected:
+        int overflow(int c) { return c; }
+};
+
+/*
+ * @brief: parse a "shm:/name:WIDTHxHEIGHT" handle
+ */
+static bool parseShmHandle(const std::string& handle, std::string& name, int& width, int& height)
+{
+    std::string prefix(SERVER_SHM_PREFIX);
+    if (handle.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+
+    size_t separator = handle.rfind(':');
+    if (separator == std::string::npos || separator < prefix.size()) {
+        return false;
+    }
+    name = handle.substr(prefix.size(), separator - prefix.size());
+
+    char x = 0;
+    std::istringstream size(handle.substr(separator + 1));
+    return !name.empty() && (size >> width >> x >> height) && x == 'x' && width > 0 && height > 0;
+}
+
+/*
+ * @brief: map an existing shared memory segment of at least size bytes
+ */
+static unsigned char* mapShm(const std::string& name, size_t size, bool writable)
+{
+    int fd = shm_open(name.c_str(), writable ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < size) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return data == MAP_FAILED ? NULL : static_cast<unsigned char*>(data);
+}
+
+static bool loadShm(const std::string& handle, Image& image)
+{
+    std::string name;
+    int width = 0;
+    int height = 0;
+    if (!parseShmHandle(handle, name, width, height)) {
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(width) * height;
+    unsigned char* data = mapShm(name, size, false);
+    if (data == NULL) {
+        return false;
+    }
+
+    std::vector<float> pixels(data, data + size);
+    munmap(data, size);
+
+    return image.setImage(std::move(pixels), width, height);
+}
+
+static bool saveShm(const std::string& handle, const Image& image)
+{
+    std::string name;
+    int width = 0;
+    int height = 0;
+    if (!parseShmHandle(handle, name, width, height) ||
+            width != image.getImageWidth() || height != image.getImageHeight()) {
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(width) * height;
+    unsigned char* data = mapShm(name, size, true);
+    if (data == NULL) {
+        return false;
+    }
+
+    std::vector<float> pixels = image.getImage();
+    for (size_t i = 0; i < size; i++) {
+        float value = pixels[i] < 0 ? 0 : (pixels[i] > 255 ? 255 : pixels[i]);
+        data[i] = static_cast<unsigned char>(value);
+    }
+    munmap(data, size);
+
+    return true;
+}
+
+static bool sendLine(int connection, const std::string& line)
+{
+    std::string message = line + "\n";
+    size_t sent = 0;
+    while (sent < message.size()) {
+        ssize_t n = send(connection, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+
+    return true;
+}
+
+Server::Server(const std::string& socketPath, int threadsNumber) :
+    m_socketPath(socketPath), m_socket(-1), m_runningJobs(0), m_stopping(false),
+    m_executor(threadsNumber)
+{
+    m_wakePipe[0] = -1;
+    m_wakePipe[1] = -1;
+}
+
+Server::~Server()
+{
+    if (m_socket >= 0) {
+        close(m_socket);
+        unlink(m_socketPath.c_str());
+    }
+    for (int i = 0; i < 2; i++) {
+        if (m_wakePipe[i] >= 0) {
+            close(m_wakePipe[i]);
+        }
+    }
+}
+
+bool Server::run()
+{
+    // Operations logs would cost more than small jobs
+    NullBuffer nullBuffer;
+    std::streambuf* coutBuffer = std::cout.rdbuf(&nullBuffer);
+
+    // Kernels are built once for the whole server life
+    std::vector<std::string> filterNames = Kernel::getFilterNames();
+    for (unsigned int i = 0; i < filterNames.size(); i++) {
+        m_kernels[filterNames[i]].setFilter(filterNames[i]);
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (m_socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long: " << m_socketPath << std::endl;
+        std::cout.rdbuf(coutBuffer);
+        return false;
+    }
+    strncpy(address.sun_path, m_socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(m_socketPath.c_str());
+    if (m_socket < 0 || pipe(m_wakePipe) != 0 ||
+            bind(m_socket, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(m_socket, SOMAXCONN) != 0) {
+        std::cerr << "Unable to listen on " << m_socketPath << ": " << strerror(errno) << std::endl;
+        std::cout.rdbuf(coutBuffer);
+        return false;
+    }
+    fcntl(m_socket, F_SETFL, fcntl(m_socket, F_GETFL) | O_NONBLOCK);
+
+    std::clog << "Listening on " << m_socketPath << " with "
+              << m_executor.getThreadsNumber() << " threads" << std::endl;
+
+    // Connections are polled here, idle ones do not hold pool threads and
+    // slow readers do not block the loop. After a shutdown request only the
+    // running requests and the unsent replies are waited for.
+    bool result = true;
+    std::vector<struct pollfd> descriptors;
+    while (!m_stopping || m_runningJobs > 0 || hasPendingOutput()) {
+        descriptors.clear();
+        descriptors.push_back({ m_wakePipe[0], POLLIN, 0 });
+        if (!m_stopping) {
+            descriptors.push_back({ m_socket, POLLIN, 0 });
+        }
+        for (std::map<int, Connection>::iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+            short events = 0;
+            if (!it->second.closing && !m_stopping) {
+                events |= POLLIN;
+            }
+            if (!it->second.output.empty()) {
+                events |= POLLOUT;
+            }
+            if (events != 0) {
+                descriptors.push_back({ it->first, events, 0 });
+            }
+        }
+
+        if (poll(descriptors.data(), descriptors.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Poll failed: " << strerror(errno) << std::endl;
+            result = false;
+            break;
+        }
+
+        if (descriptors[0].revents & POLLIN) {
+            char wake[SERVER_RECEIVE_BUFFER];
+            if (read(m_wakePipe[0], wake, sizeof(wake)) < 0 && errno != EINTR) {
+                std::cerr << "Wake pipe failed: " << strerror(errno) << std::endl;
+            }
+            sendReplies();
+        }
+
+        for (unsigned int i = 1; i < descriptors.size(); i++) {
+            if (descriptors[i].revents == 0) {
+                continue;
+            }
+
+            if (descriptors[i].fd == m_socket) {
+                if (m_stopping) {
+                    continue;
+                }
+                int connection = accept(m_socket, NULL, NULL);
+                if (connection >= 0) {
+                    fcntl(connection, F_SETFL, fcntl(connection, F_GETFL) | O_NONBLOCK);
+                    m_connections[connection] = Connection();
+                }
+                else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK &&
+                            errno != ECONNABORTED) {
+                    std::cerr << "Accept failed: " << strerror(errno) << std::endl;
+                    result = false;
+                    m_stopping = true;
+                }
+                continue;
+            }
+
+            int connection = descriptors[i].fd;
+            Connection& state = m_connections[connection];
+            if (descriptors[i].revents & POLLOUT) {
+                flushReplies(connection, state);
+            }
+            if ((descriptors[i].events & POLLIN) && !state.closing &&
+                    (descriptors[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                receiveRequests(connection, state);
+                dispatchRequest(connection, state);
+            }
+        }
+
+        // Connections are closed once their last request is answered and sent
+        for (std::map<int, Connection>::iterator it = m_connections.begin(); it != m_connections.end();) {
+            if (it->second.closing && !it->second.busy && it->second.requests.empty() &&
+                    it->second.output.empty()) {
+                close(it->first);
+                it = m_connections.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    for (std::map<int, Connection>::iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+        close(it->first);
+    }
+    m_connections.clear();
+
+    std::clog << "Server stopped" << std::endl;
+    std::cout.rdbuf(coutBuffer);
+
+    return result;
+}
+
+void Server::receiveRequests(int connection, Connection& state)
+{
+    char buffer[SERVER_RECEIVE_BUFFER];
+    ssize_t n = recv(connection, buffer, sizeof(buffer), 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        state.closing = true;
+        return;
+    }
+    state.pending.append(buffer, n);
+
+    size_t newline = 0;
+    while ((newline = state.pending.find('\n')) != std::string::npos) {
+        std::string request = state.pending.substr(0, newline);
+        state.pending.erase(0, newline + 1);
+        if (!request.empty() && request[request.size() - 1] == '\r') {
+            request.erase(request.size() - 1);
+        }
+        state.requests.push_back(request);
+    }
+}
+
+void Server::dispatchRequest(int connection, Connection& state)
+{
+    if (state.busy || state.requests.empty() || m_stopping) {
+        return;
+    }
+
+    std::string request = state.requests.front();
+    state.requests.pop_front();
+
+    if (request == SERVER_SHUTDOWN_REQUEST) {
+        m_stopping = true;
+        queueReply(connection, state, "OK shutdown");
+        state.closing = true;
+        state.requests.clear();
+        return;
+    }
+
+    state.busy = true;
+    m_runningJobs++;
+    m_executor.submit([this, connection, request]() {
+        std::string reply = this->executeRequest(request);
+        {
+            std::lock_guard<std::mutex> lock(m_repliesMutex);
+            m_replies.push_back(std::make_pair(connection, reply));
+        }
+        char wake = 0;
+        return write(m_wakePipe[1], &wake, 1) == 1;
+    });
+}
+
+void Server::sendReplies()
+{
+    std::vector<std::pair<int, std::string>> replies;
+    {
+        std::lock_guard<std::mutex> lock(m_repliesMutex);
+        replies.swap(m_replies);
+    }
+
+    for (unsigned int i = 0; i < replies.size(); i++) {
+        m_runningJobs--;
+        std::map<int, Connection>::iterator it = m_connections.find(replies[i].first);
+        if (it == m_connections.end()) {
+            continue;
+        }
+
+        Connection& state = it->second;
+        state.busy = false;
+        queueReply(it->first, state, replies[i].second);
+        dispatchRequest(it->first, state);
+    }
+}
+
+void Server::queueReply(int connection, Connection& state, const std::string& line)
+{
+    state.output += line;
+    state.output += '\n';
+    flushReplies(connection, state);
+}
+
+void Server::flushReplies(int connection, Connection& state)
+{
+    size_t sent = 0;
+    while (sent < state.output.size()) {
+        ssize_t n = send(connection, state.output.data() + sent, state.output.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n <= 0) {
+            // The peer is gone, its queued requests are dropped
+            state.closing = true;
+            state.requests.clear();
+            state.output.clear();
+            return;
+        }
+        sent += n;
+    }
+    state.output.erase(0, sent);
+}
+
+bool Server::hasPendingOutput() const
+{
+    for (std::map<int, Connection>::const_iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+        if (!it->second.output.empty()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string Server::executeRequest(const std::string& request)
+{
+    Image source;
+    Image result;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    std::istringstream fields(request);
+    std::string filterName;
+    std::string input;
+    std::string output;
+    if (!(fields >> filterName >> input >> output)) {
+        return "ERROR invalid request, expected: filter_name input output";
+    }
+
+    std::map<std::string, Kernel>::const_iterator kernel = m_kernels.find(filterName);
+    if (kernel == m_kernels.end()) {
+        return "ERROR unknown filter " + filterName;
+    }
+
+    std::string prefix(SERVER_SHM_PREFIX);
+    bool loaded = input.compare(0, prefix.size(), prefix) == 0 ?
+                    loadShm(input, source) : source.loadImage(input.c_str());
+    if (!loaded) {
+        return "ERROR unable to load " + input;
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+
+    // Jobs run concurrently on the pool, every one in its own thread
+    FilterOptions options;
+    options.threadsNumber = 1;
+    if (!source.multithreadFiltering(result, kernel->second, options)) {
+        return "ERROR filtering failed";
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    bool saved = output.compare(0, prefix.size(), prefix) == 0 ?
+                    saveShm(output, result) : result.saveImage(output.c_str());
+    if (!saved) {
+        return "ERROR unable to save " + output;
+    }
+    auto t3 = std::chrono::high_resolution_clock::now();
+
+    long long loadDuration = std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count();
+    long long filterDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    long long saveDuration = std::chrono::duration_cast<std::chrono::microseconds>(t3 - t2).count();
+    long long totalDuration = std::chrono::duration_cast<std::chrono::microseconds>(t3 - t0).count();
+
+    std::clog << filterName << " " << input << " -> " << output << ": "
+              << totalDuration << " μs" << std::endl;
+
+    return "OK " + std::to_string(totalDuration) + " " + std::to_string(loadDuration) + " " +
+            std::to_string(filterDuration) + " " + std::to_string(saveDuration);
+}
+
+bool Server::sendRequest(const std::string& socketPath, const std::string& request,
+                            std::string& reply)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0 ||
+            connect(connection, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cerr << "Unable to connect to " << socketPath << ": " << strerror(errno) << std::endl;
+        if (connection >= 0) {
+            close(connection);
+        }
+        return false;
+    }
+
+    bool result = sendLine(connection, request);
+    reply.clear();
+
+    char buffer[SERVER_RECEIVE_BUFFER];
+    while (result) {
+        ssize_t n = recv(connection, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            result = false;
+            break;
+        }
+        reply.append(buffer, n);
+        size_t newline = reply.find('\n');
+        if (newline != std::string::npos) {
+            reply.erase(newline);
+            break;
+        }
+    }
+    close(connection);
+
+    return result;
+}
@@ -0,0 +1,126 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <string>
+#include <map>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include "image.h"
+#include "executor.h"
+
+
+#define SERVER_SHM_PREFIX       "shm:"
+#define SERVER_SHUTDOWN_REQUEST "shutdown"
+
+/*
+ * @brief: Resident filtering server listening on a Unix domain socket.
+ *
+ *          Every request is a line "filter_name input output", where input
+ *          and output are png paths or shared memory handles
+ *          "shm:/name:WIDTHxHEIGHT" of 8 bit grayscale segments (the output
+ *          segment must already exist). The reply is a line
+ *          "OK total_us load_us filter_us save_us" or "ERROR message".
+ *          The line "shutdown" stops the server.
+ */
+class Server
+{
+    public:
+        /*
+         * @param: socketPath: path of the Unix domain socket
+         * @param: threadsNumber: pool threads running the requests
+         */
+        Server(const std::string& socketPath, int threadsNumber);
+
+        /*
+         *  @brief: Dtor. Removes the socket file
+         */
+        ~Server();
+
+        /*
+         * @brief: build the kernels, listen on the socket and serve the
+         *          requests until a shutdown request is received. Connections
+         *          are read and written by the calling thread without blocking,
+         *          requests run on the pool; running requests are completed and
+         *          their replies sent before returning.
+         *
+         * @return: true if the server stopped on request, false on error
+         */
+        bool run();
+
+        /*
+         * @brief: send a request line to a running server and wait for the reply
+         *
+         * @params[in]: socketPath: path of the server socket
+         * @params[in]: request: request line, without newline
+         * @params[out]: reply: reply line, without newline
+         * @return: true if a reply has been received, false otherwise
+         */
+        static bool sendRequest(const std::string& socketPath, const std::string& request,
+                                std::string& reply);
+
+    private:
+        /*
+         * @brief: State of a client connection, owned by the accept loop
+         */
+        struct Connection
+        {
+            Connection() : busy(false), closing(false) {}
+
+            std::string pending;                    ///< Received bytes after the last full line
+            std::deque<std::string> requests;       ///< Request lines waiting for the pool
+            std::string output;                     ///< Reply bytes not accepted by the socket yet
+            bool busy;                              ///< A request of the connection is running
+            bool closing;                           ///< Peer closed or send failed
+        };
+
+        /*
+         * @brief: read the available bytes of a connection and queue its lines
+         */
+        void receiveRequests(int connection, Connection& state);
+
+        /*
+         * @brief: submit the next queued request of a connection to the pool,
+         *          one at a time so that replies keep the requests order
+         */
+        void dispatchRequest(int connection, Connection& state);
+
+        /*
+         * @brief: send the replies of the completed jobs from the accept loop
+         */
+        void sendReplies();
+
+        /*
+         * @brief: queue a reply line on a connection and send what the
+         *          socket accepts, the rest is sent when it is writable
+         */
+        void queueReply(int connection, Connection& state, const std::string& line);
+
+        /*
+         * @brief: send the queued reply bytes of a connection without blocking
+         */
+        void flushReplies(int connection, Connection& state);
+
+        /*
+         * @brief: true if a connection still has reply bytes to send
+         */
+        bool hasPendingOutput() const;
+
+        /*
+         * @brief: execute a job request and return the reply line
+         */
+        std::string executeRequest(const std::string& request);
+
+        std::string m_socketPath;                   ///< Unix domain socket path
+        std::map<std::string, Kernel> m_kernels;    ///< Kernels built once at start
+        int m_socket;                               ///< Listening socket
+        int m_wakePipe[2];                          ///< Written by jobs when a reply is ready
+        std::map<int, Connection> m_connections;    ///< Open connections, accept loop only
+        int m_runningJobs;                          ///< Requests on the pool, accept loop only
+        std::vector<std::pair<int, std::string>> m_replies;    ///< Completed jobs replies
+        std::mutex m_repliesMutex;                  ///< Protects m_replies
+        bool m_stopping;                            ///< Set by a shutdown request
+        Executor m_executor;                        ///< Warm pool running the requests, destroyed first
+};
+
+#endif
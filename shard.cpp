@@ -0,0 +1,532 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <utility>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "shard.h"
+#include "tuner.h"
+#include "convolution.h"
+
+
+/*
+ * @brief: padded values of a shard input
+ */
+static size_t getShardInputSize(const ShardDescriptor& shard)
+{
+    return static_cast<size_t>(shard.stopLine - shard.startLine + shard.filterWidth - 1) *
+            (shard.width + shard.filterWidth - 1);
+}
+
+/*
+ * @brief: values of the kernel buffer: mask, column and row filters
+ */
+static size_t getKernelSize(int filterWidth)
+{
+    return static_cast<size_t>(filterWidth) * filterWidth + 2 * filterWidth;
+}
+
+static size_t getShardOutputSize(const ShardDescriptor& shard)
+{
+    return static_cast<size_t>(shard.stopLine - shard.startLine) * shard.width;
+}
+
+static bool sameShard(const ShardDescriptor& a, const ShardDescriptor& b)
+{
+    return a.index == b.index && a.startLine == b.startLine && a.stopLine == b.stopLine &&
+            a.width == b.width && a.filterWidth == b.filterWidth && a.algorithm == b.algorithm;
+}
+
+static bool writeAll(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+SharedMemoryTransport::SharedMemoryTransport() :
+    m_segment(NULL), m_size(0), m_maskSize(0), m_paddedWidth(0), m_inputSize(0), m_outputSize(0)
+{
+    m_doneChannel[0] = -1;
+    m_doneChannel[1] = -1;
+}
+
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+    close();
+}
+
+bool SharedMemoryTransport::open(const std::vector<ShardDescriptor>& shards, int height)
+{
+    static std::atomic<int> segmentsNumber(0);
+
+    close();
+    if (shards.empty()) {
+        return false;
+    }
+
+    int width = shards[0].width;
+    int filterWidth = shards[0].filterWidth;
+    m_shards = shards;
+    m_maskSize = getKernelSize(filterWidth);
+    m_paddedWidth = width + filterWidth - 1;
+    m_inputSize = (height + filterWidth - 1) * m_paddedWidth;
+    m_outputSize = static_cast<size_t>(width) * height;
+    m_size = (static_cast<size_t>(m_maskSize) + m_inputSize + m_outputSize) * sizeof(float);
+
+    // Layout: kernel | padded input | output
+    m_name = "/kernel_convolution_" + std::to_string(getpid()) + "_" +
+                std::to_string(segmentsNumber.fetch_add(1));
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "Unable to create shared memory " << m_name << ": " << strerror(errno) << std::endl;
+        m_name.clear();
+        return false;
+    }
+
+    void* segment = MAP_FAILED;
+    if (ftruncate(fd, m_size) == 0) {
+        segment = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (segment == MAP_FAILED || pipe(m_doneChannel) != 0) {
+        std::cerr << "Unable to map shared memory " << m_name << ": " << strerror(errno) << std::endl;
+        if (segment != MAP_FAILED) {
+            munmap(segment, m_size);
+        }
+        shm_unlink(m_name.c_str());
+        m_name.clear();
+        return false;
+    }
+    m_segment = static_cast<float*>(segment);
+
+    return true;
+}
+
+float* SharedMemoryTransport::getMask()
+{
+    return m_segment;
+}
+
+float* SharedMemoryTransport::getPaddedImage()
+{
+    return m_segment != NULL ? m_segment + m_maskSize : NULL;
+}
+
+bool SharedMemoryTransport::scatter()
+{
+    // Inputs are already in the segment. Only the workers keep the write
+    // end of the completion channel, so a dead worker ends the gather.
+    ::close(m_doneChannel[1]);
+    m_doneChannel[1] = -1;
+
+    return m_segment != NULL;
+}
+
+bool SharedMemoryTransport::gather(std::vector<float>& output)
+{
+    std::vector<bool> done(m_shards.size(), false);
+    for (unsigned int i = 0; i < m_shards.size(); i++) {
+        int index = -1;
+        if (!readAll(m_doneChannel[0], &index, sizeof(index)) ||
+                index < 0 || index >= static_cast<int>(m_shards.size()) || done[index]) {
+            std::cerr << "Shard worker failed" << std::endl;
+            return false;
+        }
+        done[index] = true;
+    }
+
+    // The segment is unmapped by close(): a single copy out of it
+    const float* result = m_segment + m_maskSize + m_inputSize;
+    output.assign(result, result + m_outputSize);
+
+    return true;
+}
+
+bool SharedMemoryTransport::receiveShard(int index, ShardView& view)
+{
+    if (m_segment == NULL || index < 0 || index >= static_cast<int>(m_shards.size())) {
+        return false;
+    }
+    ::close(m_doneChannel[0]);
+    m_doneChannel[0] = -1;
+
+    view.descriptor = m_shards[index];
+    view.mask = m_segment;
+    view.columnFilter = view.mask + view.descriptor.filterWidth * view.descriptor.filterWidth;
+    view.rowFilter = view.columnFilter + view.descriptor.filterWidth;
+    view.paddedRows = m_segment + m_maskSize + view.descriptor.startLine * m_paddedWidth;
+    view.outRows = m_segment + m_maskSize + m_inputSize +
+                    view.descriptor.startLine * view.descriptor.width;
+
+    return true;
+}
+
+bool SharedMemoryTransport::sendResult(const ShardView& view)
+{
+    // Output rows are already in place, just notify the coordinator
+    int index = view.descriptor.index;
+    return write(m_doneChannel[1], &index, sizeof(index)) == sizeof(index);
+}
+
+void SharedMemoryTransport::close()
+{
+    for (int i = 0; i < 2; i++) {
+        if (m_doneChannel[i] >= 0) {
+            ::close(m_doneChannel[i]);
+            m_doneChannel[i] = -1;
+        }
+    }
+    if (m_segment != NULL) {
+        munmap(m_segment, m_size);
+        m_segment = NULL;
+    }
+    if (!m_name.empty()) {
+        shm_unlink(m_name.c_str());
+        m_name.clear();
+    }
+}
+
+StreamTransport::StreamTransport()
+{}
+
+StreamTransport::~StreamTransport()
+{
+    close();
+}
+
+bool StreamTransport::open(const std::vector<ShardDescriptor>& shards, int height)
+{
+    close();
+    if (shards.empty()) {
+        return false;
+    }
+
+    int filterWidth = shards[0].filterWidth;
+    m_mask.resize(getKernelSize(filterWidth));
+    m_paddedImage.resize(static_cast<size_t>(height + filterWidth - 1) * (shards[0].width + filterWidth - 1));
+    m_shards = shards;
+
+    // Worker buffers fit the largest shard and are inherited by the
+    // workers, which do not allocate after the fork
+    size_t inputSize = 0;
+    size_t outputSize = 0;
+    for (const ShardDescriptor& shard : shards) {
+        inputSize = std::max(inputSize, getShardInputSize(shard));
+        outputSize = std::max(outputSize, getShardOutputSize(shard));
+    }
+    m_workerMask.resize(m_mask.size());
+    m_workerRows.resize(inputSize);
+    m_workerOutput.resize(outputSize);
+
+    for (unsigned int i = 0; i < shards.size(); i++) {
+        int sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0) {
+            std::cerr << "Unable to create shard stream: " << strerror(errno) << std::endl;
+            close();
+            return false;
+        }
+        m_coordinatorSockets.push_back(sockets[0]);
+        m_workerSockets.push_back(sockets[1]);
+    }
+
+    return true;
+}
+
+float* StreamTransport::getMask()
+{
+    return m_mask.data();
+}
+
+float* StreamTransport::getPaddedImage()
+{
+    return m_paddedImage.data();
+}
+
+bool StreamTransport::scatter()
+{
+    // Workers own their ends now, so a dead worker closes its stream
+    for (unsigned int i = 0; i < m_workerSockets.size(); i++) {
+        ::close(m_workerSockets[i]);
+    }
+    m_workerSockets.clear();
+
+    // Message: descriptor, kernel, padded rows with halo
+    int paddedWidth = m_shards[0].width + m_shards[0].filterWidth - 1;
+    for (unsigned int i = 0; i < m_shards.size(); i++) {
+        const ShardDescriptor& shard = m_shards[i];
+        const float* rows = m_paddedImage.data() + shard.startLine * paddedWidth;
+        if (!writeAll(m_coordinatorSockets[i], &shard, sizeof(shard)) ||
+                !writeAll(m_coordinatorSockets[i], m_mask.data(), m_mask.size() * sizeof(float)) ||
+                !writeAll(m_coordinatorSockets[i], rows, getShardInputSize(shard) * sizeof(float))) {
+            std::cerr << "Unable to send shard " << i << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool StreamTransport::gather(std::vector<float>& output)
+{
+    // Message: descriptor, output rows, received in place
+    output.resize(static_cast<size_t>(m_shards.back().stopLine) * m_shards[0].width);
+    for (unsigned int i = 0; i < m_shards.size(); i++) {
+        ShardDescriptor shard;
+        if (!readAll(m_coordinatorSockets[i], &shard, sizeof(shard)) ||
+                !sameShard(shard, m_shards[i]) ||
+                !readAll(m_coordinatorSockets[i], output.data() + shard.startLine * shard.width,
+                            getShardOutputSize(shard) * sizeof(float))) {
+            std::cerr << "Shard worker " << i << " failed" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool StreamTransport::receiveShard(int index, ShardView& view)
+{
+    if (index < 0 || index >= static_cast<int>(m_workerSockets.size())) {
+        return false;
+    }
+    for (unsigned int i = 0; i < m_coordinatorSockets.size(); i++) {
+        ::close(m_coordinatorSockets[i]);
+    }
+    m_coordinatorSockets.clear();
+
+    int fd = m_workerSockets[index];
+    if (!readAll(fd, &view.descriptor, sizeof(view.descriptor)) ||
+            view.descriptor.index != index ||
+            getKernelSize(view.descriptor.filterWidth) != m_workerMask.size() ||
+            getShardInputSize(view.descriptor) > m_workerRows.size() ||
+            getShardOutputSize(view.descriptor) > m_workerOutput.size() ||
+            !readAll(fd, m_workerMask.data(), m_workerMask.size() * sizeof(float)) ||
+            !readAll(fd, m_workerRows.data(), getShardInputSize(view.descriptor) * sizeof(float))) {
+        return false;
+    }
+
+    view.mask = m_workerMask.data();
+    view.columnFilter = view.mask + view.descriptor.filterWidth * view.descriptor.filterWidth;
+    view.rowFilter = view.columnFilter + view.descriptor.filterWidth;
+    view.paddedRows = m_workerRows.data();
+    view.outRows = m_workerOutput.data();
+
+    return true;
+}
+
+bool StreamTransport::sendResult(const ShardView& view)
+{
+    int fd = m_workerSockets[view.descriptor.index];
+    return writeAll(fd, &view.descriptor, sizeof(view.descriptor)) &&
+            writeAll(fd, view.outRows, getShardOutputSize(view.descriptor) * sizeof(float));
+}
+
+void StreamTransport::close()
+{
+    for (unsigned int i = 0; i < m_coordinatorSockets.size(); i++) {
+        ::close(m_coordinatorSockets[i]);
+    }
+    for (unsigned int i = 0; i < m_workerSockets.size(); i++) {
+        ::close(m_workerSockets[i]);
+    }
+    m_coordinatorSockets.clear();
+    m_workerSockets.clear();
+}
+
+ShardCoordinator::ShardCoordinator(ShardTransport& transport, int processesNumber) :
+    m_transport(transport), m_processesNumber(processesNumber)
+{}
+
+bool ShardCoordinator::runWorker(ShardTransport& transport, int index, float* scratch)
+{
+    ShardView view;
+    if (!transport.receiveShard(index, view)) {
+        return false;
+    }
+
+    // Same convolution as a row band of multithreadFiltering, the
+    // halo rows take the place of the neighbouring bands. The scratch
+    // buffer comes from the coordinator: no allocation after the fork.
+    ConvData data;
+    data.paddedImage = view.paddedRows;
+    data.outImage = view.outRows;
+    data.width = view.descriptor.width;
+    data.height = view.descriptor.stopLine - view.descriptor.startLine;
+    data.filterWidth = view.descriptor.filterWidth;
+    data.mask = view.mask;
+    data.columnFilter = view.columnFilter;
+    data.rowFilter = view.rowFilter;
+    if (view.descriptor.algorithm == FilterAlgorithm::VECTORIZED) {
+        convVectorized(data, 0, data.height, 0, data.width, scratch);
+    }
+    else if (view.descriptor.algorithm == FilterAlgorithm::SEPARABLE) {
+        convSeparable(data, 0, data.height, 0, data.width, scratch);
+    }
+    else {
+        convDirect(data, 0, data.height, 0, data.width);
+    }
+
+    return transport.sendResult(view);
+}
+
+bool ShardCoordinator::filter(const Image& source, Image& result, const Kernel& kernel,
+                                const FilterOptions& options)
+{
+    std::cout << "Applying sharded filter to image" << std::endl;
+
+    // Get image dimensions
+    int height = source.getImageHeight();
+    int width = source.getImageWidth();
+
+    // Get filter dimensions
+    int filterHeight = kernel.getKernelHeight();
+    int filterWidth = kernel.getKernelWidth();
+
+    if (filterHeight == 0 || filterWidth == 0 || filterHeight != filterWidth) {
+        std::cerr << "Invalid filter dimension" << std::endl;
+        return false;
+    }
+    if (height == 0 || width == 0) {
+        std::cerr << "Invalid image dimension" << std::endl;
+        return false;
+    }
+
+    int processesNumber = std::max(1, std::min(m_processesNumber, height));
+
+    // Shards are row bands, one per process: the profile picks the
+    // algorithm measured for that split
+    FilterOptions requested = options;
+    requested.threadsNumber = processesNumber;
+    requested.partition = FilterPartition::ROW_BANDS;
+    FilterAlgorithm algorithm = Tuner::resolveOptions(requested, kernel, width, height).algorithm;
+
+    std::vector<float> columnFilter;
+    std::vector<float> rowFilter;
+    if (algorithm == FilterAlgorithm::SEPARABLE &&
+            !kernel.getSeparableFilters(columnFilter, rowFilter)) {
+        std::cerr << "Kernel is not separable, using direct convolution" << std::endl;
+        algorithm = FilterAlgorithm::DIRECT;
+    }
+
+    std::cout << "Transport: " << m_transport.getName() << ", algorithm: "
+              << Tuner::getAlgorithmName(algorithm) << ", processes: "
+              << processesNumber << std::endl;
+
+    // Row shards, the first ones take the remaining rows
+    std::vector<ShardDescriptor> shards(processesNumber);
+    int startLine = 0;
+    for (int i = 0; i < processesNumber; i++) {
+        shards[i].index = i;
+        shards[i].startLine = startLine;
+        shards[i].stopLine = startLine + height / processesNumber + (i < height % processesNumber ? 1 : 0);
+        shards[i].width = width;
+        shards[i].filterWidth = filterWidth;
+        shards[i].algorithm = algorithm;
+        startLine = shards[i].stopLine;
+    }
+
+    if (!m_transport.open(shards, height)) {
+        return false;
+    }
+
+    // Input padding w.r.t. filter size, written in the transport buffers
+    auto t1 = std::chrono::high_resolution_clock::now();
+    source.buildReplicatePaddedImage(floor(filterHeight / 2), floor(filterWidth / 2),
+                                        m_transport.getPaddedImage());
+    std::vector<float> mask = kernel.getKernel();
+    float* kernelBuffer = m_transport.getMask();
+    std::fill(kernelBuffer, kernelBuffer + getKernelSize(filterWidth), 0.0f);
+    std::copy(mask.begin(), mask.end(), kernelBuffer);
+    std::copy(columnFilter.begin(), columnFilter.end(), kernelBuffer + mask.size());
+    std::copy(rowFilter.begin(), rowFilter.end(), kernelBuffer + mask.size() + filterWidth);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    auto paddingDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    std::cout << "Padding Execution time: " << paddingDuration << " μs" << std::endl;
+
+    t1 = std::chrono::high_resolution_clock::now();
+
+    // Buffered logs would be written again by every worker
+    std::cout.flush();
+    std::cerr.flush();
+
+    // Inherited by every worker, like the transport buffers: the first
+    // shard is the largest one
+    size_t scratchSize = width;
+    if (algorithm == FilterAlgorithm::SEPARABLE) {
+        scratchSize = static_cast<size_t>(width) * (shards[0].stopLine + filterWidth - 1);
+    }
+    std::vector<float> scratch(scratchSize);
+
+    bool succeeded = true;
+    std::vector<pid_t> workers;
+    for (int i = 0; i < processesNumber; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(runWorker(m_transport, i, scratch.data()) ? 0 : 1);
+        }
+        if (pid < 0) {
+            std::cerr << "Unable to start shard worker: " << strerror(errno) << std::endl;
+            succeeded = false;
+            break;
+        }
+        workers.push_back(pid);
+    }
+
+    std::vector<float> output;
+    bool gathered = succeeded && m_transport.scatter() && m_transport.gather(output);
+    if (gathered) {
+        result.setImage(std::move(output), width, height);
+    }
+
+    // Closing the transport releases workers waiting for a failed coordinator
+    m_transport.close();
+    for (unsigned int i = 0; i < workers.size(); i++) {
+        int status = 0;
+        while (waitpid(workers[i], &status, 0) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            succeeded = false;
+        }
+    }
+    t2 = std::chrono::high_resolution_clock::now();
+    auto filterDuration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
+    std::cout << "Sharded filtering execution time: " << filterDuration << " μs" << std::endl;
+
+    return succeeded && gathered;
+}
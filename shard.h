@@ -0,0 +1,215 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <string>
+#include <vector>
+#include "image.h"
+
+
+#define SHARD_TRANSPORT_SHM     "shm"
+#define SHARD_TRANSPORT_STREAM  "stream"
+
+/*
+ * @brief: A horizontal shard of the filtering job. The shard input is
+ *          the padded rows [startLine, stopLine + filterWidth - 1), i.e.
+ *          the output rows plus the halo rows shared with the neighbours.
+ */
+struct ShardDescriptor
+{
+    int index;              ///< Shard (and worker) index
+    int startLine;          ///< First output row
+    int stopLine;           ///< Output row past the last one
+    int width;              ///< Image width
+    int filterWidth;        ///< Kernel side
+    FilterAlgorithm algorithm;  ///< Convolution algorithm, resolved by the coordinator
+};
+
+/*
+ * @brief: What a worker needs to filter its shard. Pointers are owned
+ *          by the transport and valid until the result is sent.
+ */
+struct ShardView
+{
+    ShardDescriptor descriptor;
+    const float* paddedRows;        ///< First padded row of the shard input
+    const float* mask;              ///< Linearized kernel
+    const float* columnFilter;      ///< Vertical 1D filter, separable algorithm only
+    const float* rowFilter;         ///< Horizontal 1D filter, separable algorithm only
+    float* outRows;                 ///< First output row of the shard
+};
+
+/*
+ * @brief: Moves the shards inputs to the worker processes and their
+ *          outputs back to the coordinator. The coordinator calls open()
+ *          before starting the workers, then scatter() and gather(); every
+ *          worker calls receiveShard() and sendResult() for its own index.
+ */
+class ShardTransport
+{
+    public:
+        virtual ~ShardTransport() {}
+
+        virtual const char* getName() const = 0;
+
+        /*
+         * @brief: prepare the job and its input buffers. Buffers must be
+         *          alive until close()
+         *
+         * @params[in]: shards: shards of the job, indexed by descriptor index
+         * @params[in]: height: image height
+         * @return: true if successful, false otherwise
+         */
+        virtual bool open(const std::vector<ShardDescriptor>& shards, int height) = 0;
+
+        /*
+         * @brief: coordinator side, buffer of the linearized kernel followed
+         *          by the column and row filters (filterWidth values each, set
+         *          for the separable algorithm only), to be filled between
+         *          open() and scatter()
+         */
+        virtual float* getMask() = 0;
+
+        /*
+         * @brief: coordinator side, buffer of the replicate padded source
+         *          matrix, to be filled between open() and scatter()
+         */
+        virtual float* getPaddedImage() = 0;
+
+        /*
+         * @brief: coordinator side, send every worker its shard input
+         */
+        virtual bool scatter() = 0;
+
+        /*
+         * @brief: coordinator side, wait for every shard output
+         *
+         * @params[out]: output: the output matrix
+         * @return: true if every worker succeeded, false otherwise
+         */
+        virtual bool gather(std::vector<float>& output) = 0;
+
+        /*
+         * @brief: worker side, receive the shard input
+         */
+        virtual bool receiveShard(int index, ShardView& view) = 0;
+
+        /*
+         * @brief: worker side, send back the output rows of the view
+         */
+        virtual bool sendResult(const ShardView& view) = 0;
+
+        /*
+         * @brief: release the job resources
+         */
+        virtual void close() = 0;
+};
+
+/*
+ * @brief: Single POSIX shared memory segment holding the kernel, the
+ *          padded input and the output matrix. The coordinator pads the
+ *          image straight into the segment, workers read their rows, halo
+ *          included, and write their output in place: nothing is copied
+ *          between processes.
+ */
+class SharedMemoryTransport : public ShardTransport
+{
+    public:
+        SharedMemoryTransport();
+        ~SharedMemoryTransport();
+
+        const char* getName() const { return SHARD_TRANSPORT_SHM; }
+        bool open(const std::vector<ShardDescriptor>& shards, int height);
+        float* getMask();
+        float* getPaddedImage();
+        bool scatter();
+        bool gather(std::vector<float>& output);
+        bool receiveShard(int index, ShardView& view);
+        bool sendResult(const ShardView& view);
+        void close();
+
+    private:
+        std::string m_name;                         ///< Segment name
+        float* m_segment;                           ///< Mapped segment
+        size_t m_size;                              ///< Segment size in bytes
+        std::vector<ShardDescriptor> m_shards;
+        int m_maskSize;                             ///< Kernel values
+        int m_paddedWidth;                          ///< Padded row length
+        int m_inputSize;                            ///< Padded matrix values
+        size_t m_outputSize;                        ///< Output matrix values
+        int m_doneChannel[2];                       ///< Pipe of the completed shard indexes
+};
+
+/*
+ * @brief: Message based transport over a stream socket per worker, a
+ *          local stand-in for workers on other machines: every shard input
+ *          (descriptor, kernel, rows with halo) and every output is
+ *          serialized on the stream, in host byte order.
+ */
+class StreamTransport : public ShardTransport
+{
+    public:
+        StreamTransport();
+        ~StreamTransport();
+
+        const char* getName() const { return SHARD_TRANSPORT_STREAM; }
+        bool open(const std::vector<ShardDescriptor>& shards, int height);
+        float* getMask();
+        float* getPaddedImage();
+        bool scatter();
+        bool gather(std::vector<float>& output);
+        bool receiveShard(int index, ShardView& view);
+        bool sendResult(const ShardView& view);
+        void close();
+
+    private:
+        std::vector<float> m_paddedImage;           ///< Coordinator input buffers
+        std::vector<float> m_mask;
+        std::vector<ShardDescriptor> m_shards;
+        std::vector<int> m_coordinatorSockets;      ///< Coordinator end, by shard
+        std::vector<int> m_workerSockets;           ///< Worker end, by shard
+        std::vector<float> m_workerMask;            ///< Worker receive buffers,
+        std::vector<float> m_workerRows;            ///< allocated before the fork
+        std::vector<float> m_workerOutput;
+};
+
+/*
+ * @brief: Filters an image with worker processes, one per shard. Workers
+ *          are forked for every job, convolve their shard and exit.
+ */
+class ShardCoordinator
+{
+    public:
+        /*
+         * @param: transport: transport between coordinator and workers
+         * @param: processesNumber: number of worker processes
+         */
+        ShardCoordinator(ShardTransport& transport, int processesNumber);
+
+        /*
+         * @brief: apply kernel to source, every worker convolving its shard
+         *
+         * @params[in]: source: image to be filtered
+         * @params[out]: result: filtered image
+         * @params[in]: kernel: kernel to be applied
+         * @params[in]: options: convolution algorithm, automatic options are
+         *              resolved with the tuning profile for the processes number
+         * @return: true if every worker succeeded, false otherwise
+         */
+        bool filter(const Image& source, Image& result, const Kernel& kernel,
+                    const FilterOptions& options = FilterOptions());
+
+    private:
+        /*
+         * @brief: body of a worker process
+         *
+         * @params[in]: scratch: convolution buffer, a row for the vectorized
+         *              algorithm or the horizontal pass of the largest shard
+         *              for the separable one, allocated before the fork
+         */
+        static bool runWorker(ShardTransport& transport, int index, float* scratch);
+
+        ShardTransport& m_transport;
+        int m_processesNumber;
+};
+
+#endif
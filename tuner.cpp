@@ -0,0 +1,361 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <thread>
+#include "tuner.h"
+
+
+#define TUNING_DEFAULT_TILE_SIZE    128
+#define TUNING_REPETITIONS          2
+
+std::vector<TuningEntry> Tuner::s_entries;
+bool Tuner::s_loaded = false;
+std::mutex Tuner::s_mutex;
+
+/*
+ * @brief: A representative workload measured while tuning
+ */
+struct TuningWorkload
+{
+    int width;
+    int height;
+    int kernelSize;
+    bool gaussian;          ///< Separable gaussian, otherwise a non separable kernel
+};
+
+static int getHardwareThreads()
+{
+    int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+static bool buildTuningKernel(Kernel& kernel, const TuningWorkload& workload)
+{
+    if (workload.gaussian) {
+        return kernel.setGaussianFilter(workload.kernelSize, workload.kernelSize,
+                                        workload.kernelSize / 6.0f);
+    }
+    if (workload.kernelSize == 5) {
+        return kernel.setGaussianLaplacianFilter();
+    }
+    return kernel.setSharpenFilter();
+}
+
+bool Tuner::tune(const char* profilePath, int maxThreads)
+{
+    if (maxThreads <= 0) {
+        maxThreads = getHardwareThreads();
+    }
+
+    const TuningWorkload workloads[] = {
+        { 512, 512, 3, false },
+        { 512, 512, 5, false },
+        { 512, 512, 5, true },
+        { 512, 512, 7, true },
+        { 512, 512, 15, true },
+        { 2048, 1024, 3, false },
+        { 2048, 1024, 5, false },
+        { 2048, 1024, 5, true },
+        { 2048, 1024, 7, true },
+        { 2048, 1024, 15, true }
+    };
+
+    std::vector<int> threadsCandidates;
+    for (int t = 1; t < maxThreads; t *= 2) {
+        threadsCandidates.push_back(t);
+    }
+    threadsCandidates.push_back(maxThreads);
+
+    const FilterAlgorithm algorithms[] = { FilterAlgorithm::DIRECT,
+                                           FilterAlgorithm::VECTORIZED,
+                                           FilterAlgorithm::SEPARABLE };
+    const int tileSizes[] = { 0, 64, 256 };       ///< 0 stands for row bands
+
+    std::vector<TuningEntry> entries;
+
+    for (const TuningWorkload& workload : workloads) {
+        // Image content does not affect timings
+        std::vector<float> pixels(workload.width * workload.height);
+        for (unsigned int i = 0; i < pixels.size(); i++) {
+            pixels[i] = static_cast<float>(rand() % 256);
+        }
+        Image source;
+        source.setImage(pixels, workload.width, workload.height);
+        Image result;
+        Kernel kernel;
+
+        // Silence the filtering logs while measuring
+        std::streambuf* coutBuffer = std::cout.rdbuf(NULL);
+        buildTuningKernel(kernel, workload);
+        bool separable = kernel.isSeparable();
+        std::cout.rdbuf(coutBuffer);
+
+        TuningEntry best;
+        best.mpixelsPerSecond = 0;
+
+        for (int threads : threadsCandidates) {
+            for (FilterAlgorithm algorithm : algorithms) {
+                if (algorithm == FilterAlgorithm::SEPARABLE && !separable) {
+                    continue;
+                }
+                for (int tileSize : tileSizes) {
+                    FilterOptions options;
+                    options.threadsNumber = threads;
+                    options.algorithm = algorithm;
+                    options.partition = tileSize > 0 ? FilterPartition::TILES :
+                                                        FilterPartition::ROW_BANDS;
+                    options.tileSize = tileSize;
+
+                    double bestSeconds = 0;
+                    coutBuffer = std::cout.rdbuf(NULL);
+                    for (int r = 0; r < TUNING_REPETITIONS; r++) {
+                        auto t1 = std::chrono::high_resolution_clock::now();
+                        source.multithreadFiltering(result, kernel, options);
+                        auto t2 = std::chrono::high_resolution_clock::now();
+                        double seconds = std::chrono::duration<double>(t2 - t1).count();
+                        if (r == 0 || seconds < bestSeconds) {
+                            bestSeconds = seconds;
+                        }
+                    }
+                    std::cout.rdbuf(coutBuffer);
+
+                    TuningEntry entry;
+                    entry.kernelSize = workload.kernelSize;
+                    entry.separable = separable;
+                    entry.pixels = workload.width * workload.height;
+                    entry.options = options;
+                    entry.mpixelsPerSecond = entry.pixels / bestSeconds / 1e6;
+                    entries.push_back(entry);
+
+                    if (entry.mpixelsPerSecond > best.mpixelsPerSecond) {
+                        best = entry;
+                    }
+                }
+            }
+        }
+
+        std::cout << "Kernel " << workload.kernelSize << "x" << workload.kernelSize
+                  << (separable ? " separable" : "") << ", image "
+                  << workload.width << "x" << workload.height << ": "
+                  << getAlgorithmName(best.options.algorithm) << ", "
+                  << getPartitionName(best.options.partition);
+        if (best.options.partition == FilterPartition::TILES) {
+            std::cout << " " << best.options.tileSize;
+        }
+        std::cout << ", threads: " << best.options.threadsNumber << " ("
+                  << best.mpixelsPerSecond << " Mpixel/s)" << std::endl;
+    }
+
+    if (!saveProfile(profilePath, entries)) {
+        return false;
+    }
+
+    std::cout << "Profile saved in " << std::string(profilePath) << std::endl;
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_entries = entries;
+    s_loaded = true;
+
+    return true;
+}
+
+bool Tuner::saveProfile(const char* profilePath, const std::vector<TuningEntry>& entries)
+{
+    std::ofstream file(profilePath);
+    if (!file) {
+        std::cerr << "Unable to write profile " << std::string(profilePath) << std::endl;
+        return false;
+    }
+
+    file << "# kernel_convolution tuning profile" << std::endl;
+    file << "# kernel_size separable pixels threads algorithm partition tile_size mpixel_per_s" << std::endl;
+    for (const TuningEntry& entry : entries) {
+        file << entry.kernelSize << " " << (entry.separable ? 1 : 0) << " "
+             << entry.pixels << " " << entry.options.threadsNumber << " "
+             << getAlgorithmName(entry.options.algorithm) << " "
+             << getPartitionName(entry.options.partition) << " "
+             << entry.options.tileSize << " " << entry.mpixelsPerSecond << std::endl;
+    }
+
+    return static_cast<bool>(file);
+}
+
+bool Tuner::loadProfile(const char* profilePath)
+{
+    std::ifstream file(profilePath);
+    if (!file) {
+        return false;
+    }
+
+    std::vector<TuningEntry> entries;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        TuningEntry entry;
+        int separable = 0;
+        std::string algorithm;
+        std::string partition;
+        if (!(fields >> entry.kernelSize >> separable >> entry.pixels
+                     >> entry.options.threadsNumber >> algorithm >> partition
+                     >> entry.options.tileSize >> entry.mpixelsPerSecond)) {
+            std::cerr << "Invalid profile line: " << line << std::endl;
+            return false;
+        }
+        entry.separable = separable != 0;
+
+        if (algorithm == getAlgorithmName(FilterAlgorithm::DIRECT)) {
+            entry.options.algorithm = FilterAlgorithm::DIRECT;
+        }
+        else if (algorithm == getAlgorithmName(FilterAlgorithm::VECTORIZED)) {
+            entry.options.algorithm = FilterAlgorithm::VECTORIZED;
+        }
+        else if (algorithm == getAlgorithmName(FilterAlgorithm::SEPARABLE)) {
+            entry.options.algorithm = FilterAlgorithm::SEPARABLE;
+        }
+        else {
+            std::cerr << "Invalid profile algorithm: " << algorithm << std::endl;
+            return false;
+        }
+
+        if (partition == getPartitionName(FilterPartition::TILES)) {
+            entry.options.partition = FilterPartition::TILES;
+        }
+        else {
+            entry.options.partition = FilterPartition::ROW_BANDS;
+        }
+
+        entries.push_back(entry);
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_entries = entries;
+    s_loaded = true;
+
+    return true;
+}
+
+FilterOptions Tuner::resolveOptions(const FilterOptions& options, const Kernel& kernel,
+                                    int width, int height)
+{
+    FilterOptions resolved = options;
+
+    bool automatic = options.threadsNumber <= 0 ||
+                        options.algorithm == FilterAlgorithm::AUTO ||
+                        options.partition == FilterPartition::AUTO ||
+                        (options.partition == FilterPartition::TILES && options.tileSize <= 0);
+
+    if (automatic) {
+        // The profile is read once, a missing profile is not an error
+        bool load = false;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            load = !s_loaded;
+            s_loaded = true;
+        }
+        if (load) {
+            loadProfile(getProfilePath().c_str());
+        }
+
+        std::lock_guard<std::mutex> lock(s_mutex);
+
+        // Nearest measured workload among the entries compatible with
+        // the fixed options, then the fastest configuration for it
+        bool separable = kernel.isSeparable();
+        int pixels = width * height;
+        const TuningEntry* best = NULL;
+        double bestDistance = 0;
+        for (const TuningEntry& entry : s_entries) {
+            if (entry.separable != separable) {
+                continue;
+            }
+            if (options.threadsNumber > 0 && entry.options.threadsNumber != options.threadsNumber) {
+                continue;
+            }
+            if (options.algorithm != FilterAlgorithm::AUTO &&
+                    entry.options.algorithm != options.algorithm) {
+                continue;
+            }
+            if (options.partition != FilterPartition::AUTO &&
+                    entry.options.partition != options.partition) {
+                continue;
+            }
+
+            double distance = std::fabs(std::log2(static_cast<double>(kernel.getKernelWidth()) / entry.kernelSize)) +
+                                std::fabs(std::log2(static_cast<double>(pixels) / entry.pixels)) / 2;
+            if (best == NULL || distance < bestDistance - 1e-9 ||
+                    (distance < bestDistance + 1e-9 && entry.mpixelsPerSecond > best->mpixelsPerSecond)) {
+                best = &entry;
+                bestDistance = distance;
+            }
+        }
+
+        if (best != NULL) {
+            if (options.threadsNumber <= 0) {
+                resolved.threadsNumber = best->options.threadsNumber;
+            }
+            if (options.algorithm == FilterAlgorithm::AUTO) {
+                resolved.algorithm = best->options.algorithm;
+            }
+            if (options.partition == FilterPartition::AUTO) {
+                resolved.partition = best->options.partition;
+            }
+            if (options.tileSize <= 0) {
+                resolved.tileSize = best->options.tileSize;
+            }
+        }
+    }
+
+    // Defaults when the profile has no answer
+    if (resolved.threadsNumber <= 0) {
+        resolved.threadsNumber = getHardwareThreads();
+    }
+    if (resolved.algorithm == FilterAlgorithm::AUTO) {
+        resolved.algorithm = FilterAlgorithm::DIRECT;
+    }
+    if (resolved.partition == FilterPartition::AUTO) {
+        resolved.partition = FilterPartition::ROW_BANDS;
+    }
+    if (resolved.partition == FilterPartition::TILES && resolved.tileSize <= 0) {
+        resolved.tileSize = TUNING_DEFAULT_TILE_SIZE;
+    }
+
+    return resolved;
+}
+
+std::string Tuner::getProfilePath()
+{
+    const char* path = getenv(TUNING_PROFILE_ENV);
+    if (path != NULL && path[0] != '\0') {
+        return std::string(path);
+    }
+
+    return std::string(TUNING_PROFILE_DEFAULT_PATH);
+}
+
+const char* Tuner::getAlgorithmName(FilterAlgorithm algorithm)
+{
+    switch (algorithm)
+    {
+        case FilterAlgorithm::DIRECT:       return "direct";
+        case FilterAlgorithm::VECTORIZED:   return "vectorized";
+        case FilterAlgorithm::SEPARABLE:    return "separable";
+        default:                            return "auto";
+    }
+}
+
+const char* Tuner::getPartitionName(FilterPartition partition)
+{
+    switch (partition)
+    {
+        case FilterPartition::ROW_BANDS:    return "row_bands";
+        case FilterPartition::TILES:        return "tiles";
+        default:                            return "auto";
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include "image.h"
+
+
+#define TUNING_PROFILE_ENV              "KERNEL_CONVOLUTION_PROFILE"
+#define TUNING_PROFILE_DEFAULT_PATH     "kernel_convolution.profile"
+
+/*
+ * @brief: A measured filtering configuration
+ */
+struct TuningEntry
+{
+    int kernelSize;             ///< Kernel side
+    bool separable;             ///< True if the kernel was separable
+    int pixels;                 ///< Number of pixels of the measured image
+    FilterOptions options;      ///< Measured configuration
+    double mpixelsPerSecond;    ///< Measured throughput
+};
+
+/*
+ * @brief: Measures filtering configurations on the current machine and
+ *          picks the fastest one for the filtering entry points
+ */
+class Tuner
+{
+    public:
+        /*
+         * @brief: measure every candidate configuration for representative
+         *          image and kernel sizes and write the profile
+         *
+         * @params[in]: profilePath: the path where to save the profile
+         * @params[in]: maxThreads: largest threads number to be measured
+         * @return: true if successful, false otherwise
+         */
+        static bool tune(const char* profilePath, int maxThreads);
+
+        /*
+         * @brief: load a profile, replacing the current one
+         *
+         * @params[in]: profilePath: the path of the profile
+         * @return: true if successful, false otherwise
+         */
+        static bool loadProfile(const char* profilePath);
+
+        /*
+         * @brief: replace AUTO values (and 0 threads) of options with the
+         *          fastest matching configuration of the profile. The profile is
+         *          loaded from getProfilePath() on first use. Without a matching
+         *          entry, direct convolution on row bands is used.
+         *
+         * @params[in]: options: requested options
+         * @params[in]: kernel: kernel to be applied
+         * @params[in]: width: image width
+         * @params[in]: height: image height
+         * @return: options without AUTO values
+         */
+        static FilterOptions resolveOptions(const FilterOptions& options, const Kernel& kernel,
+                                            int width, int height);
+
+        /*
+         * @brief: return the profile path, from the KERNEL_CONVOLUTION_PROFILE
+         *          environment variable or the default one
+         */
+        static std::string getProfilePath();
+
+        static const char* getAlgorithmName(FilterAlgorithm algorithm);
+
+        static const char* getPartitionName(FilterPartition partition);
+
+    private:
+        /*
+         * @brief: write the entries in the profile file
+         */
+        static bool saveProfile(const char* profilePath, const std::vector<TuningEntry>& entries);
+
+        static std::vector<TuningEntry> s_entries;      ///< Loaded profile
+        static bool s_loaded;                           ///< True once a profile load has been tried
+        static std::mutex s_mutex;                      ///< Protects the profile
+};
+
+#endif